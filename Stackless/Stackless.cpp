@@ -3,6 +3,8 @@
 
 #include "stdafx.h"
 
+#include <string>
+
 namespace stackless {
 	namespace microthreading {
 		ThreadId thread_counter = 0;
@@ -12,9 +14,16 @@ namespace stackless {
 namespace implementations {
 	namespace brainfck {
 		void BFTest();
+		int bf_batch_main(int argc, char *argv[]);
+		int bf_check_main(int argc, char *argv[]);
+		int bf_bench_main(int argc, char *argv[]);
+	}
+	namespace scale {
+		int thread_bench_main(int argc, char *argv[]);
 	}
 	namespace scheme {
 		void scheme_test();
+		int scheme_main(int argc, char *argv[]);
 		unsigned scheme_complete_test();
 	}
 }
@@ -24,8 +33,18 @@ namespace references {
 	}
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+	if (argc > 1 && std::string(argv[1]) == "bf-batch")
+		return implementations::brainfck::bf_batch_main(argc - 2, argv + 2);
+	if (argc > 1 && std::string(argv[1]) == "bf-check")
+		return implementations::brainfck::bf_check_main(argc - 2, argv + 2);
+	if (argc > 1 && std::string(argv[1]) == "bf-bench")
+		return implementations::brainfck::bf_bench_main(argc - 2, argv + 2);
+	if (argc > 1 && std::string(argv[1]) == "thread-bench")
+		return implementations::scale::thread_bench_main(argc - 2, argv + 2);
+	if (argc > 1 && std::string(argv[1]) == "scheme")
+		return implementations::scheme::scheme_main(argc - 2, argv + 2);
 	//implementations::brainfck::BFTest();
 	//references::scheme::scheme_complete_test();
 	//implementations::scheme::scheme_test();
@@ -1,13 +1,48 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <ostream>
 #include <queue>
 #include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#ifdef __linux__
+#include <climits>
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+// Labels as values, for direct-threaded dispatch loops
+#if defined(__GNUC__) && !defined(STACKLESS_NO_COMPUTED_GOTO)
+#define STACKLESS_COMPUTED_GOTO
+#endif
+
+// The time stamp counter, for timing short intervals cheaply
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && !defined(STACKLESS_NO_TSC)
+#define STACKLESS_TSC
+#include <x86intrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) && !defined(STACKLESS_NO_TSC)
+#define STACKLESS_TSC
+#include <intrin.h>
+#endif
+
 namespace stackless {
 	template<typename OperationType, typename ArgSizeType, typename ArgsType>
 	class InvalidOperation : public std::exception {
@@ -30,6 +65,26 @@ namespace stackless {
 		typedef typename InstructionType::_instruction_type _instruction_type;
 	};
 
+	// Calls Dispatcher<op>::dispatch for an operation known only at run time,
+	// through a table of every Dispatcher<Op>::dispatch for Op below Count
+	// built at compile time. Operations without a specialization get the
+	// unspecialized Dispatcher, which typically throws InvalidOperation.
+	template<typename OperationType, template<OperationType> class Dispatcher, OperationType Count, typename Result, typename... Args>
+	struct DispatchTable {
+		typedef Result (*handler_type)(Args...);
+
+		static Result dispatch(const OperationType op, Args... args) {
+			return handlers(std::make_index_sequence<static_cast<std::size_t>(Count)>())[op](args...);
+		}
+
+	private:
+		template<std::size_t... Index>
+		static const handler_type *handlers(std::index_sequence<Index...>) {
+			static constexpr handler_type table[] = { &Dispatcher<static_cast<OperationType>(Index)>::dispatch... };
+			return table;
+		}
+	};
+
 	template<typename ListType>
 	struct Environment {
 		typedef typename ListType::value_type _value_type;
@@ -62,10 +117,638 @@ namespace stackless {
 		CellType result;
 	};
 
+	namespace memory {
+		// Thrown when an arena would grow past its quota
+		struct QuotaExceeded : public std::bad_alloc {
+			const char *what() const noexcept {
+				return "microthread memory quota exceeded";
+			}
+		};
+
+		// Memory belonging to one microthread, limited to a quota of live
+		// bytes. Small blocks are carved from chunks with a bump pointer and
+		// recycled through a free list per size class. The chunks all go back
+		// to the system at once when the arena is destroyed, which happens
+		// once the thread and everything it allocated are gone.
+		// Blocks may be freed from other OS threads, so access is locked.
+		class Arena : public std::enable_shared_from_this<Arena> {
+		public:
+			explicit Arena(const std::size_t quota) : quota(quota), used(0), next(nullptr), end(nullptr), chunks(nullptr), free_lists(), released(false) {
+			}
+			~Arena() {
+				while (chunks != nullptr) {
+					Chunk *chunk = chunks;
+					chunks = chunk->next;
+					std::free(chunk);
+				}
+			}
+			Arena(const Arena &) = delete;
+			Arena &operator = (const Arena &) = delete;
+
+			// An arena that lives until both the last reference to it and
+			// the last block allocated from it are gone, so that blocks may
+			// outlive the thread that allocated them
+			static std::shared_ptr<Arena> create(const std::size_t quota) {
+				return std::shared_ptr<Arena>(new Arena(quota), [](Arena *arena) { arena->release(); });
+			}
+
+			void *allocate(std::size_t size) {
+				size = round(size);
+				std::lock_guard<std::mutex> guard(lock);
+				if (used + size > quota)
+					throw QuotaExceeded();
+				if (size > largest_class) {
+					void *block = std::malloc(size);
+					if (block == nullptr)
+						throw std::bad_alloc();
+					used += size;
+					return block;
+				}
+				FreeBlock *&free_list = free_lists[size / alignment - 1];
+				if (free_list != nullptr) {
+					FreeBlock *block = free_list;
+					free_list = block->next;
+					used += size;
+					return block;
+				}
+				if (next == nullptr || (std::size_t)(end - next) < size) {
+					Chunk *chunk = static_cast<Chunk *>(std::malloc(chunk_size));
+					if (chunk == nullptr)
+						throw std::bad_alloc();
+					chunk->next = chunks;
+					chunks = chunk;
+					next = reinterpret_cast<char *>(chunk) + sizeof(Chunk);
+					end = reinterpret_cast<char *>(chunk) + chunk_size;
+				}
+				void *block = next;
+				next += size;
+				used += size;
+				return block;
+			}
+			void deallocate(void *block, std::size_t size) {
+				size = round(size);
+				std::unique_lock<std::mutex> guard(lock);
+				used -= size;
+				if (size > largest_class) {
+					std::free(block);
+				} else {
+					FreeBlock *&free_list = free_lists[size / alignment - 1];
+					free_list = new(block) FreeBlock{ free_list };
+				}
+				const bool last = released && used == 0;
+				guard.unlock();
+				if (last)
+					delete this;
+			}
+
+			std::size_t getQuota() const { return quota; }
+			// Bytes currently allocated
+			std::size_t getUsed() const { return used; }
+
+		private:
+			struct FreeBlock { FreeBlock *next; };
+			// Heads each chunk, keeping blocks 16 byte aligned
+			struct alignas(16) Chunk { Chunk *next; };
+			static const std::size_t alignment = 16;
+			static const std::size_t largest_class = 1024;
+			static const std::size_t chunk_size = 16 * 1024;
+			static std::size_t round(const std::size_t size) {
+				return (size + alignment - 1) & ~(alignment - 1);
+			}
+
+			// The last reference is gone; go once the blocks are too
+			void release() {
+				std::unique_lock<std::mutex> guard(lock);
+				released = true;
+				const bool last = used == 0;
+				guard.unlock();
+				if (last)
+					delete this;
+			}
+
+			const std::size_t quota;
+			std::size_t used;
+			char *next, *end;
+			Chunk *chunks;
+			FreeBlock *free_lists[largest_class / alignment];
+			bool released;
+			std::mutex lock;
+		};
+		typedef std::shared_ptr<Arena> arena_p;
+
+		// The arena of the microthread running on this OS thread, if any
+		inline Arena *&current_arena() {
+			static thread_local Arena *arena = nullptr;
+			return arena;
+		}
+
+		// Makes an arena current for the lifetime of the scope
+		struct ArenaScope {
+			ArenaScope(Arena *arena) : outer(current_arena()) {
+				current_arena() = arena;
+			}
+			~ArenaScope() {
+				current_arena() = outer;
+			}
+		private:
+			Arena *const outer;
+		};
+
+		// Allocate from the current arena, or the global heap when there is
+		// none. The block remembers where it came from, so it can be freed
+		// from anywhere. The arena must outlive the block, as those made
+		// with Arena::create do.
+		struct BlockHeader {
+			Arena *arena;
+			std::size_t size;
+		};
+		static_assert(sizeof(BlockHeader) == 16, "block header keeps blocks 16 byte aligned");
+		inline void *allocate(const std::size_t size) {
+			Arena *arena = current_arena();
+			const std::size_t total = size + sizeof(BlockHeader);
+			BlockHeader *header = static_cast<BlockHeader *>(arena ? arena->allocate(total) : std::malloc(total));
+			if (header == nullptr)
+				throw std::bad_alloc();
+			header->arena = arena;
+			header->size = total;
+			return header + 1;
+		}
+		inline void deallocate(void *block) {
+			if (block == nullptr)
+				return;
+			BlockHeader *header = static_cast<BlockHeader *>(block) - 1;
+			if (header->arena)
+				header->arena->deallocate(header, header->size);
+			else
+				std::free(header);
+		}
+
+		// Standard allocator over an arena, for use with std::allocate_shared.
+		// Each copy keeps the arena alive.
+		template<typename T>
+		struct ArenaAllocator {
+			typedef T value_type;
+
+			ArenaAllocator(arena_p arena) : arena(arena) {
+			}
+			template<typename U>
+			ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {
+			}
+
+			T *allocate(const std::size_t n) {
+				return static_cast<T *>(arena->allocate(n * sizeof(T)));
+			}
+			void deallocate(T *block, const std::size_t n) {
+				arena->deallocate(block, n * sizeof(T));
+			}
+
+			template<typename U>
+			bool operator == (const ArenaAllocator<U> &other) const { return arena == other.arena; }
+			template<typename U>
+			bool operator != (const ArenaAllocator<U> &other) const { return arena != other.arena; }
+
+			arena_p arena;
+		};
+
+		// Standard allocator over whichever arena is current when a block is
+		// allocated, or the global heap when none is. It holds no state, so
+		// containers of data a thread owns can use it in place of
+		// std::allocator, and be charged to the thread that fills them.
+		template<typename T>
+		struct ThreadAllocator {
+			typedef T value_type;
+
+			ThreadAllocator() {
+			}
+			template<typename U>
+			ThreadAllocator(const ThreadAllocator<U> &) {
+			}
+
+			T *allocate(const std::size_t n) {
+				return static_cast<T *>(memory::allocate(n * sizeof(T)));
+			}
+			void deallocate(T *block, const std::size_t) {
+				memory::deallocate(block);
+			}
+
+			template<typename U>
+			bool operator == (const ThreadAllocator<U> &) const { return true; }
+			template<typename U>
+			bool operator != (const ThreadAllocator<U> &) const { return false; }
+		};
+
+		// Create an object in the current arena, or on the global heap
+		template<typename T, typename... Args>
+		std::shared_ptr<T> make_shared(Args&&... args) {
+			if (Arena *arena = current_arena())
+				return std::allocate_shared<T>(ArenaAllocator<T>(arena->shared_from_this()), std::forward<Args>(args)...);
+			return std::shared_ptr<T>(new T(std::forward<Args>(args)...));
+		}
+
+		// Blocks of one size for objects made in great numbers, such as the
+		// state of each of a million threads. Blocks carry no header and are
+		// carved from large chunks, which are kept for reuse and never given
+		// back to the system. Blocks may be freed from other OS threads, so
+		// access is locked.
+		template<std::size_t Size, std::size_t Align>
+		class Pool {
+		public:
+			// The pool for this size. It is never destroyed, as blocks may
+			// still be freed during static destruction.
+			static Pool &instance() {
+				static Pool *pool = new Pool();
+				return *pool;
+			}
+			Pool(const Pool &) = delete;
+			Pool &operator = (const Pool &) = delete;
+
+			void *allocate() {
+				std::lock_guard<std::mutex> guard(lock);
+				if (free_list != nullptr) {
+					FreeBlock *block = free_list;
+					free_list = block->next;
+					return block;
+				}
+				if (next == end) {
+					next = static_cast<char *>(std::malloc(chunk_size));
+					if (next == nullptr)
+						throw std::bad_alloc();
+					end = next + chunk_size - chunk_size % block_size;
+				}
+				void *block = next;
+				next += block_size;
+				return block;
+			}
+			void deallocate(void *block) {
+				std::lock_guard<std::mutex> guard(lock);
+				free_list = new(block) FreeBlock{ free_list };
+			}
+
+		private:
+			Pool() : next(nullptr), end(nullptr), free_list(nullptr) {
+			}
+			struct FreeBlock { FreeBlock *next; };
+			static_assert(Align <= alignof(std::max_align_t), "pool blocks are only aligned as operator new aligns");
+			static const std::size_t block_size = ((Size < sizeof(FreeBlock) ? sizeof(FreeBlock) : Size) + Align - 1) & ~(Align - 1);
+			static const std::size_t chunk_size = 64 * 1024;
+
+			char *next, *end;
+			FreeBlock *free_list;
+			std::mutex lock;
+		};
+
+		// Standard allocator over the pool for the size of T
+		template<typename T>
+		struct PoolAllocator {
+			typedef T value_type;
+
+			PoolAllocator() {
+			}
+			template<typename U>
+			PoolAllocator(const PoolAllocator<U> &) {
+			}
+
+			T *allocate(const std::size_t n) {
+				if (n != 1)
+					return static_cast<T *>(::operator new(n * sizeof(T)));
+				return static_cast<T *>(Pool<sizeof(T), alignof(T)>::instance().allocate());
+			}
+			void deallocate(T *block, const std::size_t n) {
+				if (n != 1)
+					::operator delete(block);
+				else
+					Pool<sizeof(T), alignof(T)>::instance().deallocate(block);
+			}
+
+			template<typename U>
+			bool operator == (const PoolAllocator<U> &) const { return true; }
+			template<typename U>
+			bool operator != (const PoolAllocator<U> &) const { return false; }
+		};
+
+		// Create an object from the pool for its size, with its reference
+		// count in the same block. In the current arena, if any, the object
+		// is made there instead so that it counts against the quota.
+		template<typename T, typename... Args>
+		std::shared_ptr<T> make_pooled(Args&&... args) {
+			if (current_arena() != nullptr)
+				return memory::make_shared<T>(std::forward<Args>(args)...);
+			return std::allocate_shared<T>(PoolAllocator<T>(), std::forward<Args>(args)...);
+		}
+	}
+
+	namespace profiling {
+		// Sampling profiler over the call stacks of microthreads. A sample is
+		// taken every interval steps, or each time a timer fires. Samples are
+		// aggregated as folded stacks, one "thread 1;outer;inner count" line
+		// per distinct stack, which flamegraph.pl and compatible tools read.
+		class Profiler {
+		public:
+			typedef std::vector<std::string> stack_type;
+
+			// Sample every interval steps
+			explicit Profiler(const unsigned long interval)
+				: interval(interval), countdown(interval), due(false), samples(0), stopping(false) {
+			}
+			// Sample whenever period has passed, timed by a background thread
+			explicit Profiler(const std::chrono::microseconds period)
+				: interval(0), countdown(0), due(false), samples(0), stopping(false)
+			{
+				timer = std::thread([this, period]() {
+					std::unique_lock<std::mutex> guard(lock);
+					while (!stop.wait_for(guard, period, [this]() { return stopping; }))
+						due.store(true, std::memory_order_relaxed);
+				});
+			}
+			~Profiler() {
+				if (timer.joinable()) {
+					{
+						std::lock_guard<std::mutex> guard(lock);
+						stopping = true;
+					}
+					stop.notify_all();
+					timer.join();
+				}
+			}
+			Profiler(const Profiler &) = delete;
+			Profiler &operator = (const Profiler &) = delete;
+
+			// Count steps taken. Returns: true when a sample is due. A run of
+			// steps spanning several intervals still gives one sample.
+			bool step(const unsigned long steps = 1) {
+				if (interval != 0) {
+					if (countdown > steps) {
+						countdown -= steps;
+						return false;
+					}
+					countdown = interval;
+					return true;
+				}
+				if (!due.load(std::memory_order_relaxed))
+					return false;
+				due.store(false, std::memory_order_relaxed);
+				return true;
+			}
+
+			// Add a sample of a stack, outermost frame first
+			void record(const std::string &thread, const stack_type &stack) {
+				std::string key(thread);
+				for (const std::string &frame : stack) {
+					key += ';';
+					// ; separates frames in the folded format
+					for (char c : frame)
+						key += c == ';' ? ':' : c;
+				}
+				++folded[key];
+				++samples;
+			}
+
+			// Write the samples in folded format
+			void write(std::ostream &out) const {
+				for (const auto &entry : folded)
+					out << entry.first << ' ' << entry.second << '\n';
+			}
+			unsigned long sampleCount() const { return samples; }
+			void clear() {
+				folded.clear();
+				samples = 0;
+			}
+
+		private:
+			const unsigned long interval;
+			unsigned long countdown;
+			std::atomic<bool> due;
+			std::map<std::string, unsigned long> folded;
+			unsigned long samples;
+			std::thread timer;
+			std::mutex lock;
+			std::condition_variable stop;
+			bool stopping;
+		};
+	}
+
+	namespace timekeeping {
+		template<typename TimeType, typename ClockType>
+		struct Timekeeper
+		{
+			template<class Callback>
+			static unsigned long long measure(Callback cb) {
+				auto start = ClockType::now();
+				cb();
+				auto end = ClockType::now();
+				return std::chrono::duration_cast<TimeType>(end - start).count();
+			}
+		};
+
+		typedef Timekeeper<typename std::chrono::milliseconds, typename std::chrono::steady_clock> StacklessTimekeeper;
+
+		// A counter for timing short intervals: the time stamp counter where
+		// there is one, else the steady clock in nanoseconds. Ticks are only
+		// meaningful as differences on one machine; convert with toNanos.
+		inline uint64_t ticks() {
+#ifdef STACKLESS_TSC
+			return __rdtsc();
+#else
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+		}
+		// Nanoseconds per tick, measured against the steady clock the first
+		// time it is asked for, which takes a few milliseconds
+		inline double nanosPerTick() {
+#ifdef STACKLESS_TSC
+			static const double rate = []() {
+				typedef std::chrono::steady_clock clock;
+				const clock::time_point start = clock::now();
+				const uint64_t first = ticks();
+				clock::time_point end;
+				do
+					end = clock::now();
+				while (end - start < std::chrono::milliseconds(5));
+				const uint64_t elapsed = ticks() - first;
+				return elapsed == 0 ? 1.0 : std::chrono::duration<double, std::nano>(end - start).count() / elapsed;
+			}();
+			return rate;
+#else
+			return 1.0;
+#endif
+		}
+		inline uint64_t toNanos(const uint64_t ticks) {
+			return (uint64_t)(ticks * nanosPerTick());
+		}
+
+		// Counts of values, such as latencies in nanoseconds, kept to about
+		// 3% precision whatever their size: values are bucketed by power of
+		// two, and each power of two split into 32 linear steps, as an HDR
+		// histogram does. Recording is a few instructions and no allocation.
+		// Not locked; give each OS thread its own and merge them.
+		class Histogram {
+		public:
+			Histogram() : counts((std::size_t)slots, 0), total(0), smallest(UINT64_MAX), largest(0), sum(0) {
+			}
+
+			void record(const uint64_t value, const uint64_t count = 1) {
+				counts[slot(value)] += count;
+				total += count;
+				sum += value * count;
+				if (value < smallest)
+					smallest = value;
+				if (value > largest)
+					largest = value;
+			}
+			void merge(const Histogram &other) {
+				for (std::size_t n = 0; n < slots; ++n)
+					counts[n] += other.counts[n];
+				total += other.total;
+				sum += other.sum;
+				if (other.smallest < smallest)
+					smallest = other.smallest;
+				if (other.largest > largest)
+					largest = other.largest;
+			}
+			void clear() {
+				counts.assign((std::size_t)slots, 0);
+				total = sum = largest = 0;
+				smallest = UINT64_MAX;
+			}
+
+			uint64_t count() const { return total; }
+			uint64_t min() const { return total == 0 ? 0 : smallest; }
+			uint64_t max() const { return largest; }
+			double mean() const { return total == 0 ? 0 : (double)sum / total; }
+			// The value at or below which percent of the values fall,
+			// reported as the highest value of its bucket
+			uint64_t percentile(const double percent) const {
+				if (total == 0)
+					return 0;
+				uint64_t rank = (uint64_t)(percent / 100 * total + 0.5);
+				if (rank == 0)
+					rank = 1;
+				if (rank > total)
+					rank = total;
+				uint64_t seen = 0;
+				for (std::size_t n = 0; n < slots; ++n) {
+					seen += counts[n];
+					if (seen >= rank)
+						return std::min(std::max(highest(n), smallest), largest);
+				}
+				return largest;
+			}
+
+			// Write "name count=N p50=.. p99=.. p999=.. max=.." with values
+			// divided by scale, such as 1000 for nanoseconds to microseconds
+			void write(std::ostream &out, const std::string &name, const double scale = 1) const {
+				const std::ios_base::fmtflags flags = out.flags();
+				const std::streamsize precision = out.precision(3);
+				out.setf(std::ios_base::fixed, std::ios_base::floatfield);
+				out << name << " count=" << total
+					<< " p50=" << percentile(50) / scale
+					<< " p99=" << percentile(99) / scale
+					<< " p999=" << percentile(99.9) / scale
+					<< " max=" << max() / scale << '\n';
+				out.flags(flags);
+				out.precision(precision);
+			}
+
+		private:
+			static const unsigned sub_bits = 6;
+			static const uint64_t half = uint64_t(1) << (sub_bits - 1);
+			static const std::size_t slots = (64 - sub_bits + 2) * half;
+
+			static unsigned msb(const uint64_t value) {
+#ifdef __GNUC__
+				return 63 - __builtin_clzll(value);
+#else
+				unsigned bit = 0;
+				for (uint64_t v = value; v >>= 1; )
+					++bit;
+				return bit;
+#endif
+			}
+			// Values under 64 have a slot each; above that, the top sub_bits
+			// bits of the value pick the slot
+			static std::size_t slot(const uint64_t value) {
+				if (value < (half << 1))
+					return (std::size_t)value;
+				const unsigned shift = msb(value) - sub_bits + 1;
+				return (std::size_t)(shift * half + (value >> shift));
+			}
+			static uint64_t highest(const std::size_t slot) {
+				if (slot < (half << 1))
+					return slot;
+				const unsigned shift = (unsigned)(slot / half - 1);
+				const uint64_t mantissa = slot % half + half;
+				return ((mantissa + 1) << shift) - 1;
+			}
+
+			std::vector<uint64_t> counts;
+			uint64_t total, smallest, largest, sum;
+		};
+
+		// Histograms of time in nanoseconds, one for each named phase
+		class PhaseTimers {
+		public:
+			Histogram &phase(const std::string &name) {
+				return phases[name];
+			}
+			const Histogram *find(const std::string &name) const {
+				auto it = phases.find(name);
+				return it == phases.end() ? nullptr : &it->second;
+			}
+			// Write each phase in microseconds
+			void write(std::ostream &out) const {
+				for (const auto &entry : phases)
+					entry.second.write(out, entry.first + " us", 1000);
+			}
+			void clear() {
+				phases.clear();
+			}
+
+		private:
+			std::map<std::string, Histogram> phases;
+		};
+
+		// Records the time from construction to destruction, in
+		// nanoseconds, into a histogram. Does nothing with nullptr, so that
+		// timing can be left in place and switched off.
+		class ScopedTimer {
+		public:
+			explicit ScopedTimer(Histogram *histogram) : histogram(histogram), start(histogram ? ticks() : 0) {
+			}
+			~ScopedTimer() {
+				if (histogram != nullptr)
+					histogram->record(toNanos(ticks() - start));
+			}
+			ScopedTimer(const ScopedTimer &) = delete;
+			ScopedTimer &operator = (const ScopedTimer &) = delete;
+
+		private:
+			Histogram *const histogram;
+			const uint64_t start;
+		};
+	}
+
+	// How a run of steps by executeN ended
+	enum ExecuteStatus {
+		// The whole budget was used and there is more to do
+		BudgetUsed,
+		// The thread went to sleep, or waits for a message or I/O
+		Blocked,
+		// The thread has finished
+		Resolved,
+	};
+	struct ExecuteResult {
+		unsigned steps;
+		ExecuteStatus status;
+	};
+
 	namespace microthreading {
 		enum WaitState {
 			Stop = 0,
 			Run,
+			// Blocked until a message is delivered to the mailbox
+			Message,
+			// Blocked until a file descriptor is ready
+			Io,
 		};
 
 		typedef unsigned CycleCount;
@@ -81,6 +764,151 @@ namespace stackless {
 		using ThreadTimePoint = std::chrono::steady_clock::time_point;
 		using ThreadTimeUnit = std::chrono::milliseconds;
 
+		// Messages a thread has not yet taken. Most threads never receive
+		// one, so the queue is allocated with the first message and freed
+		// again with the last.
+		template<typename T>
+		class Mailbox {
+		public:
+			Mailbox() {
+			}
+			Mailbox(const Mailbox &other) : queue(other.queue ? new std::queue<T>(*other.queue) : nullptr) {
+			}
+			Mailbox(Mailbox &&other) = default;
+			Mailbox &operator = (Mailbox other) {
+				queue = std::move(other.queue);
+				return *this;
+			}
+
+			bool empty() const { return !queue || queue->empty(); }
+			std::size_t size() const { return queue ? queue->size() : 0; }
+			T &front() { return queue->front(); }
+			const T &front() const { return queue->front(); }
+			void push(const T &message) { get().push(message); }
+			void push(T &&message) { get().push(std::move(message)); }
+			void pop() {
+				queue->pop();
+				if (queue->empty())
+					queue.reset();
+			}
+
+		private:
+			std::queue<T> &get() {
+				if (!queue)
+					queue.reset(new std::queue<T>());
+				return *queue;
+			}
+
+			std::unique_ptr<std::queue<T>> queue;
+		};
+
+		// How a thread ended, as given to those waiting on it
+		template<typename CellType>
+		struct Completion {
+			ThreadId thread_id;
+			// False when the thread was removed before it finished
+			bool resolved;
+			CellType result;
+			// Set when the thread failed, such as by exceeding its quota
+			std::exception_ptr failure;
+		};
+
+		// The outcome of a thread, filled in once it finishes. Copies share
+		// the one outcome.
+		template<typename CellType>
+		class ThreadFuture {
+		public:
+			typedef Completion<CellType> _completion_type;
+
+			ThreadFuture() : state(std::make_shared<State>()) {
+			}
+
+			bool isReady() const { return state->ready; }
+			// Only meaningful once ready
+			const _completion_type &completion() const { return state->completion; }
+			// Returns: the thread's result.
+			// Throws: the thread's failure, or std::runtime_error if it is not
+			// ready or the thread was removed before it finished.
+			const CellType &get() const {
+				if (!state->ready)
+					throw std::runtime_error("thread has not finished");
+				if (state->completion.failure)
+					std::rethrow_exception(state->completion.failure);
+				if (!state->completion.resolved)
+					throw std::runtime_error("thread removed before it finished");
+				return state->completion.result;
+			}
+			// Called by the manager, once
+			void set(const _completion_type &completion) {
+				state->completion = completion;
+				state->ready = true;
+			}
+
+		private:
+			struct State {
+				bool ready = false;
+				_completion_type completion;
+			};
+			std::shared_ptr<State> state;
+		};
+
+		// Threads waited on together. Each member counts down once as it
+		// finishes. Once none are left and the group has been joined, the
+		// waiters are called, each once. Waiting is a counter, so fan-in
+		// over thousands of threads costs nothing per tick.
+		template<typename CellType>
+		class ThreadGroup {
+		public:
+			typedef Completion<CellType> _completion_type;
+			typedef std::function<void(ThreadGroup &)> _waiter_type;
+
+			ThreadGroup() : members(0), running(0), joined(false) {
+			}
+			ThreadGroup(const ThreadGroup &) = delete;
+			ThreadGroup &operator = (const ThreadGroup &) = delete;
+
+			std::size_t size() const { return members; }
+			// Members yet to finish
+			std::size_t remaining() const { return running; }
+			bool isDone() const { return joined && running == 0; }
+			// The members that have finished, in the order they did
+			const std::vector<_completion_type> &completions() const { return finished; }
+
+			// No more members will be added. Calls waiter, if given, once all
+			// members have finished; at once if they already have.
+			void join(_waiter_type waiter = nullptr) {
+				joined = true;
+				if (waiter)
+					waiters.push_back(std::move(waiter));
+				if (running == 0)
+					notify();
+			}
+
+			// Called by the manager as members are added and finish
+			void expect() {
+				++members;
+				++running;
+			}
+			void finish(const _completion_type &completion) {
+				finished.push_back(completion);
+				if (--running == 0 && joined)
+					notify();
+			}
+
+		private:
+			void notify() {
+				std::vector<_waiter_type> ready;
+				ready.swap(waiters);
+				for (auto &waiter : ready)
+					waiter(*this);
+			}
+
+			std::size_t members, running;
+			bool joined;
+			std::vector<_completion_type> finished;
+			std::vector<_waiter_type> waiters;
+		};
+
 		struct MicrothreadBase {
 			const ThreadId thread_id;
 			virtual bool isResolved() = 0;
@@ -93,41 +921,89 @@ namespace stackless {
 			}
 		};
 
+		// final, so that the manager's calls on its threads are direct.
+		// A thread is kept to 64 bytes, with anything most threads never
+		// need allocated apart on first use, so that a manager can hold a
+		// million of them. Threads move, but are not copied.
 		template<typename Implementation>
-		struct Microthread : public MicrothreadBase {
+		struct Microthread final : public MicrothreadBase {
 			typedef Microthread<Implementation> _thread_type;
 			typedef typename Implementation::_frame_type _frame_type;
 			typedef typename Implementation::_env_type _env_type;
 			typedef typename std::shared_ptr<Implementation> impl_p;
 			typedef typename Implementation::_cell_type _cell_type;
-			typedef std::queue<_cell_type> _mailbox_type;
+			typedef Mailbox<_cell_type> _mailbox_type;
+			typedef Completion<_cell_type> _completion_type;
+			typedef std::function<void(const _completion_type &)> _waiter_type;
 
-			// Whether this thread is being watched, or should be cleaned up automatically
-			bool watched = false;
-
-			impl_p impl;
 			CycleCount cycles;
+		private:
+			// State few threads have
+			struct ColdState {
+				// Memory the thread allocates from, or null for the global heap
+				memory::arena_p arena;
+				// Set when the thread failed, such as by exceeding its quota
+				std::exception_ptr failure;
+				// Called when the thread finishes or is removed
+				std::vector<_waiter_type> waiters;
+			};
+			// Declared before impl so that the arena outlives the thread's frames
+			std::unique_ptr<ColdState> cold;
+			ColdState &getCold() {
+				if (!cold)
+					cold.reset(new ColdState());
+				return *cold;
+			}
+		public:
+			impl_p impl;
 			_mailbox_type mailbox;
 			ThreadTimePoint sleep_until = ThreadTimePoint::min();
+			// Whether this thread is being watched, or should be cleaned up automatically
+			bool watched = false;
 			bool sleeping = false;
+			WaitState wait_state = Run;
 
 			template<typename Callback, typename Args>
 			Microthread(Callback cb, Args args, const ThreadId thread_id, const CycleCount cycle_count = cycles_med)
-				: MicrothreadBase(thread_id), cycles(cycle_count), mailbox()
+				: MicrothreadBase(thread_id), cycles(cycle_count)
 			{
 				impl = impl_p(cb(args));
 			}
 
 			template<typename Callback>
 			Microthread(Callback cb, const ThreadId thread_id, const CycleCount cycle_count = cycles_med)
-				: MicrothreadBase(thread_id), cycles(cycle_count), mailbox()
+				: MicrothreadBase(thread_id), cycles(cycle_count)
 			{
 				impl = impl_p(cb());
 			}
 
+			Microthread(Microthread &&other) = default;
+
 			_frame_type &getCurrentFrame() { return impl->getCurrentFrame(); }
 			const _frame_type &getCurrentFrame() const { return impl->getCurrentFrame(); }
-			bool isResolved() { return getCurrentFrame().isResolved(); }
+			bool isResolved() { return (cold && cold->failure != nullptr) || impl->isFrameResolved(); }
+
+			memory::Arena *getArena() const { return cold ? cold->arena.get() : nullptr; }
+			void setArena(memory::arena_p arena) {
+				if (arena)
+					getCold().arena = arena;
+			}
+			std::exception_ptr getFailure() const { return cold ? cold->failure : nullptr; }
+			void setFailure(std::exception_ptr failure) { getCold().failure = failure; }
+
+			void addWaiter(_waiter_type waiter) { getCold().waiters.push_back(std::move(waiter)); }
+			// Tell the waiters how the thread ended. Each is called once, as
+			// they are let go before any is called.
+			void signal(const bool resolved) {
+				if (!cold || cold->waiters.empty())
+					return;
+				std::vector<_waiter_type> waiters;
+				waiters.swap(cold->waiters);
+				const _completion_type completion{ thread_id, resolved,
+					resolved && !cold->failure ? getResult() : _cell_type(), cold->failure };
+				for (auto &waiter : waiters)
+					waiter(completion);
+			}
 			typename Implementation::_cell_type getResult() const {
 				const _frame_type &frame = getCurrentFrame();
 				return frame.result;
@@ -146,6 +1022,12 @@ namespace stackless {
 				impl->execute();
 				return true;
 			}
+			// Run up to budget steps in the implementation's own loop
+			ExecuteResult executeN(const CycleCount budget) {
+				if (sleeping)
+					return ExecuteResult{ 0, Blocked };
+				return impl->executeN(budget);
+			}
 
 			template<typename ArgType, class Callback>
 			static _thread_type create(ArgType args, Callback cb, const ThreadId thread_id, const CycleCount cycle_count = cycles_med) {
@@ -163,15 +1045,29 @@ namespace stackless {
 					mailbox.push(message);
 				}
 			}
+			void deliver_message(_cell_type &&message) {
+				if (false == impl->deliver_message(message)) {
+					// Not handled, move it into the mailbox
+					mailbox.push(std::move(message));
+				}
+			}
 
 			void notify_sleep() {
 				sleeping = true;
+				impl->blocked = true;
 				impl->notify_sleep();
 			}
 			void notify_wake() {
 				sleeping = false;
+				wait_state = Run;
+				impl->blocked = false;
 				impl->notify_wake();
 			}
+
+			// Whether the thread waits for a message or an fd with no timeout
+			bool isParked() const {
+				return (wait_state == Message || wait_state == Io) && sleep_until == ThreadTimePoint::max();
+			}
 		};
 		
 		enum Threading {
@@ -194,6 +1090,12 @@ namespace stackless {
 			typedef typename std::pair<ThreadId,_thread_type> _threads_ele;
 			typedef typename _threads_type::const_iterator _threads_const_iterator;
 			typedef typename _threads_type::iterator _threads_iterator;
+			typedef typename _thread_type::_mailbox_type _mailbox_type;
+			typedef typename _thread_type::_completion_type _completion_type;
+			typedef typename _thread_type::_waiter_type _waiter_type;
+			typedef ThreadFuture<_cell_type> _future_type;
+			typedef ThreadGroup<_cell_type> _group_type;
+			typedef std::shared_ptr<_group_type> group_p;
 
 			// Custom type used to manage scheduling set
 			struct SchedulingInformation {
@@ -203,7 +1105,10 @@ namespace stackless {
 				}
 
 				bool operator < (const SchedulingInformation &other) const {
-					return time_point < other.time_point;
+					// Order by time, threads due at the same time by id
+					if (time_point != other.time_point)
+						return time_point < other.time_point;
+					return thread_id < other.thread_id;
 				}
 
 				const ThreadId thread_id;
@@ -211,40 +1116,134 @@ namespace stackless {
 			};
 			typedef std::set<SchedulingInformation> _scheduling_type;
 
-			MicrothreadManager() : threads(), current_thread(threads.begin()), scheduling(), thread_counter(0) {
+			MicrothreadManager() : threads(), parked(), current_thread(threads.begin()), scheduling(), thread_counter(0) {
+			}
+			virtual ~MicrothreadManager() {
+#ifdef __linux__
+				if (io_fd >= 0)
+					close(io_fd);
+#endif
 			}
 
 			template<typename ArgType, class Callback>
 			ThreadId start(ArgType args, Callback cb, const CycleCount cycle_count = cycles_med) {
-				ThreadId thread_id = thread_counter++;
-				_thread_type thread(_thread_type::template create<ArgType, Callback>(args, cb, thread_id, cycle_count));
-				threads.insert(_threads_ele(thread_id, thread));
-				return thread_id;
+				return insert([&args, &cb, cycle_count](const ThreadId thread_id) {
+					return _thread_type::template create<ArgType, Callback>(args, cb, thread_id, cycle_count);
+				});
 			}
 			template<class Callback>
 			ThreadId start(Callback cb, const CycleCount cycle_count = cycles_med) {
-				ThreadId thread_id = thread_counter++;
-				_thread_type thread(_thread_type::template create<Callback>(cb, thread_id, cycle_count));
-				threads.insert(_threads_ele(thread_id, thread));
-				return thread_id;
+				return insert([&cb, cycle_count](const ThreadId thread_id) {
+					return _thread_type::template create<Callback>(cb, thread_id, cycle_count);
+				});
+			}
+
+			// Sample the stacks of running threads into profiler, or stop
+			// sampling with nullptr. The profiler must outlive its use here.
+			void setProfiler(profiling::Profiler *p) {
+				profiler = p;
+			}
+			// Time the scheduler into timers, or stop timing with nullptr.
+			// The phases are "tick", each call of executeThreads; "slice",
+			// each thread's time slice; and "wake late", how long past its
+			// time a sleeping thread was woken. The timers must outlive
+			// their use here.
+			void setTimers(timekeeping::PhaseTimers *t) {
+				timers = t;
+				tick_time = t ? &t->phase("tick") : nullptr;
+				slice_time = t ? &t->phase("slice") : nullptr;
+				wake_late = t ? &t->phase("wake late") : nullptr;
+			}
+			timekeeping::PhaseTimers *getTimers() const {
+				return timers;
+			}
+
+			// Give threads started from now on an arena of their own, limited
+			// to quota bytes. A thread over its quota fails alone, with
+			// memory::QuotaExceeded as its failure. 0 allocates from the
+			// global heap without a limit. Only what the implementation
+			// allocates through memory:: counts: its frames and environments,
+			// and containers that use memory::ThreadAllocator. The manager's
+			// own records never come from a thread's arena.
+			void setThreadQuota(const std::size_t quota) {
+				thread_quota = quota;
+			}
+			std::size_t getThreadQuota() const {
+				return thread_quota;
 			}
 
-			const _threads_const_iterator getThread(const ThreadId index) const {
-				return threads.find(index);
+			// A thread, running or parked, or nullptr if there is no such
+			// thread. Looking a thread up does not move it.
+			const _thread_type *getThread(const ThreadId index) const {
+				auto it = threads.find(index);
+				if (it != threads.end())
+					return &it->second;
+				it = parked.find(index);
+				return it == parked.end() ? nullptr : &it->second;
 			}
-			_threads_iterator getThread(const ThreadId index) {
-				return threads.find(index);
+			_thread_type *getThread(const ThreadId index) {
+				return const_cast<_thread_type *>(static_cast<const MicrothreadManager *>(this)->getThread(index));
 			}
 			void thread_remove_scheduling(_threads_iterator thread) {
 				auto it = getSchedulingFor(thread);
 				if (it != scheduling.end()) {
-					scheduling.erase(*it);
+					scheduling.erase(it);
 				}
 			}
 			void remove_thread(const ThreadId thread_ref) {
-				auto thread = getThread(thread_ref);
+				_threads_type *from = &threads;
+				auto thread = threads.find(thread_ref);
+				if (thread == threads.end()) {
+					from = &parked;
+					thread = parked.find(thread_ref);
+					if (thread == parked.end())
+						return;
+				}
 				thread_remove_scheduling(thread);
-				threads.erase(thread);
+#ifdef __linux__
+				forget_fd_wait(thread_ref);
+#endif
+				if (from == &threads && thread == current_thread)
+					current_thread = threads.end();
+				thread->second.signal(thread->second.isResolved());
+				from->erase(thread);
+			}
+
+			// Call waiter once the thread finishes, or is removed; at once if
+			// it has already finished. Waiters are called from within the
+			// manager, and may start threads and send messages, but not
+			// remove threads. Threads still running when the manager is
+			// destroyed do not call theirs.
+			// Returns: false if there is no such thread.
+			bool onComplete(const ThreadId thread_ref, _waiter_type waiter) {
+				_thread_type *thread = getThread(thread_ref);
+				if (thread == nullptr)
+					return false;
+				thread->addWaiter(std::move(waiter));
+				if (thread->isResolved())
+					thread->signal(true);
+				return true;
+			}
+			// The outcome of a thread. For a thread that does not exist, it is
+			// ready at once, as for a removed thread.
+			_future_type future(const ThreadId thread_ref) {
+				_future_type result;
+				if (!onComplete(thread_ref, [result](const _completion_type &completion) mutable {
+					result.set(completion);
+				}))
+					result.set(_completion_type{ thread_ref, false, _cell_type(), nullptr });
+				return result;
+			}
+			// Add a thread to group, which must not have been joined yet.
+			// Returns: false if there is no such thread.
+			bool addToGroup(group_p group, const ThreadId thread_ref) {
+				if (getThread(thread_ref) == nullptr)
+					return false;
+				group->expect();
+				onComplete(thread_ref, [group](const _completion_type &completion) {
+					group->finish(completion);
+				});
+				return true;
 			}
 
 			// Sleep for duration from current time
@@ -256,24 +1255,103 @@ namespace stackless {
 				std::cerr << ", target=" << target.time_since_epoch().count();
 				std::cerr << ", diff=" << (target - now).count() << std::endl;
 #endif
-				auto thread = getThread(thread_ref);
+				auto thread = unpark(thread_ref);
 				thread_remove_scheduling(thread);
 				scheduling.emplace(SchedulingInformation(thread_ref, target));
 				thread->second.sleep_until = target;
 				thread->second.notify_sleep();
 			}
 			void thread_sleep_forever(const ThreadId thread_ref) {
-				auto thread = getThread(thread_ref);
+				auto thread = unpark(thread_ref);
 				thread_remove_scheduling(thread);
 				scheduling.emplace(SchedulingInformation(thread_ref, ThreadTimePoint::max()));
 				thread->second.sleep_until = ThreadTimePoint::max();
 				thread->second.notify_sleep();
 			}
 			void thread_wake(const ThreadId thread_ref) {
-				auto thread = getThread(thread_ref);
+				auto thread = unpark(thread_ref);
 				thread_remove_scheduling(thread);
 				thread->second.notify_wake();
 			}
+			// Block until a message is delivered. The thread leaves the
+			// scheduler entirely until then, so it costs nothing per tick.
+			void thread_wait_message(const ThreadId thread_ref) {
+				auto thread = unpark(thread_ref);
+				thread_remove_scheduling(thread);
+				thread->second.sleep_until = ThreadTimePoint::max();
+				thread->second.wait_state = Message;
+				thread->second.notify_sleep();
+			}
+			// Block until a message is delivered, or the duration passes
+			void thread_wait_message_for(const ThreadId thread_ref, const ThreadTimeUnit &duration) {
+				thread_sleep_for(thread_ref, duration);
+				getThread(thread_ref)->wait_state = Message;
+			}
+#ifdef __linux__
+			// Block until fd is ready for events (EPOLLIN, EPOLLOUT). The
+			// thread is parked, and woken by executeThreads once epoll reports
+			// the fd. Only one thread may wait on a given fd at a time.
+			// Returns: false if the fd cannot be waited on.
+			bool thread_wait_fd(const ThreadId thread_ref, const int fd, const uint32_t events) {
+				if (io_fd < 0 && (io_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+					return false;
+				struct epoll_event event = {};
+				event.events = events;
+				event.data.fd = fd;
+				if (epoll_ctl(io_fd, EPOLL_CTL_ADD, fd, &event) < 0)
+					return false;
+				// Added afresh, so a waiter left on this number was waiting on
+				// an fd since closed
+				auto stale = io_waiters.find(fd);
+				if (stale != io_waiters.end())
+					wake_fd_waiter(stale);
+				io_waiters[fd] = thread_ref;
+				auto thread = unpark(thread_ref);
+				thread_remove_scheduling(thread);
+				thread->second.sleep_until = ThreadTimePoint::max();
+				thread->second.wait_state = Io;
+				thread->second.notify_sleep();
+				return true;
+			}
+			// Drop the wait on fd, if any, before the fd is closed. epoll
+			// forgets a closed fd by itself, but the waiter would stay
+			// parked, and the next fd given the same number would find it.
+			// The waiting thread is woken, to find the fd closed.
+			void forget_fd(const int fd) {
+				auto waiter = io_waiters.find(fd);
+				if (waiter == io_waiters.end())
+					return;
+				epoll_ctl(io_fd, EPOLL_CTL_DEL, fd, nullptr);
+				wake_fd_waiter(waiter);
+			}
+#endif
+
+			// Save a thread to path with its implementation's
+			// checkpoint(path, mailbox, args...), then remove it and free its
+			// memory. resume brings it back, here or in another process.
+			// The thread must not be the one running.
+			// Returns: false if there is no such thread.
+			template<typename... Args>
+			bool suspend(const ThreadId thread_ref, const std::string &path, Args&&... args) {
+				_thread_type *thread = getThread(thread_ref);
+				if (thread == nullptr)
+					return false;
+				thread->impl->checkpoint(path, thread->mailbox, std::forward<Args>(args)...);
+				remove_thread(thread_ref);
+				return true;
+			}
+			// Start a thread from a checkpoint written by suspend, with the
+			// implementation's restore(path, mailbox, args...).
+			// Returns: the id of the new thread.
+			template<typename... Args>
+			ThreadId resume(const std::string &path, Args&&... args) {
+				_mailbox_type mailbox;
+				const ThreadId thread_id = start([&]() {
+					return Implementation::restore(path, mailbox, std::forward<Args>(args)...);
+				});
+				getThread(thread_id)->mailbox = std::move(mailbox);
+				return thread_id;
+			}
 
 			bool shouldRunThread(_threads_iterator thread) {
 				return thread->second.isResolved() || isThreadScheduled(thread);
@@ -281,52 +1359,89 @@ namespace stackless {
 
 			bool executeThread(_threads_iterator thread) {
 				current_thread = thread;
-				bool executed = false;
-				for (CycleCount cycle = thread->second.cycles; cycle > 0; --cycle) {
-					if (shouldRunThread(thread) == false)
-						return executed;
-					if (!thread->second.execute())
-						return executed;
-					executed = true;
+				bool executed = false, finished = false;
+				{
+					memory::ArenaScope scope(thread->second.getArena());
+					try {
+						// Checked once a slice; the implementation stops early
+						// itself if the thread blocks or resolves
+						if (shouldRunThread(thread) == false)
+							return false;
+						timekeeping::ScopedTimer timer(slice_time);
+						const ExecuteResult result = thread->second.executeN(thread->second.cycles);
+						executed = result.steps != 0;
+						finished = result.status == Resolved;
+						if (profiler != nullptr && executed && profiler->step(result.steps))
+							sample(thread);
+					} catch (...) {
+						// The thread is resolved with the failure, be it a
+						// quota exceeded or any other; others carry on
+						thread->second.setFailure(std::current_exception());
+						executed = finished = true;
+					}
 				}
+				// Outside the thread's arena, as waiters are not the thread's
+				if (finished)
+					thread->second.signal(true);
 				return executed;
 			}
 
+			// A parked thread cannot be run alone, as nothing could wake it.
 			void runThreadToCompletion(const ThreadId index, const Threading mode = Single) {
+				_thread_type *record = getThread(index);
 				_threads_iterator thread = threads.find(index);
-				if (thread == threads.end())
+				if (record == nullptr || (mode == Single && thread == threads.end()))
 					return;
-				thread->second.watched = true;
-				while (!thread->second.isResolved()) {
+				record->watched = true;
+				bool finished = false;
+				onComplete(index, [&finished](const _completion_type &) {
+					finished = true;
+				});
+				while (!finished) {
 					if (mode == Single)
 						// Run single thread
 						executeThread(thread);
-					else if(mode == Multi) {
-						// Run other threads
+					else if(mode == Multi)
+						// Run other threads alongside it
 						executeThreads();
-						if(thread->second.isResolved())
-							break;
-					}
 				}
 			}
+			// Run all threads until every member of group has finished,
+			// joining it if it has not been
+			void runGroupToCompletion(group_p group) {
+				group->join();
+				while (!group->isDone())
+					executeThreads();
+			}
 
 			int executeThreads() {
+				timekeeping::ScopedTimer timer(tick_time);
 				int threads_run = 0;
 				bool unwatched_resolved = false;
-				for (auto it = threads.begin(); it != threads.end(); ++it) {
+				for (auto it = threads.begin(); it != threads.end(); ) {
 					if (it->second.isResolved()) {
 						if(it->second.watched == false)
 							unwatched_resolved = true;
+						++it;
 						continue;
 					}
-					if (isThreadScheduled(it) == false) {
-						continue;
-					}
-					if(executeThread(it))
+					if (isThreadScheduled(it) && executeThread(it))
 						++threads_run;
 					if (it->second.watched == false && it->second.isResolved())
 						unwatched_resolved = true;
+					if (it->second.isParked()) {
+						// Set aside until a message arrives
+						if (it == current_thread)
+							current_thread = threads.end();
+						parked.emplace(it->first, std::move(it->second));
+						it = threads.erase(it);
+					} else
+						++it;
 				}
+#ifdef __linux__
+				// With nothing else to do, wait for I/O up to the next timer
+				threads_run += poll_io(threads_run == 0);
+#endif
 				if(unwatched_resolved)
 					idle();
 				yield_process(unwatched_resolved, threads_run);
@@ -338,49 +1453,163 @@ namespace stackless {
 			}
 
 			bool hasThreads() const {
-				return threads.empty() == false;
+				return threads.empty() == false || parked.empty() == false;
 			}
 			typename _threads_type::size_type threadCount() const {
-				return threads.size();
+				return threads.size() + parked.size();
+			}
+			// Number of threads parked waiting for a message
+			typename _threads_type::size_type parkedCount() const {
+				return parked.size();
 			}
 
-			// Send a message to a thread.
+			// Send a message to a thread, waking it if it waits for one.
 			// Returns: true on success, false on thread not existing.
 			bool send(const _cell_type &message, const ThreadId thread_id) {
-				auto it = threads.find(thread_id);
-				if (it == threads.end())
+				_thread_type *thread = getThread(thread_id);
+				if (thread == nullptr)
+					return false;
+				thread->deliver_message(message);
+				wake_for_message(thread_id);
+				return true;
+			}
+			bool send(_cell_type &&message, const ThreadId thread_id) {
+				_thread_type *thread = getThread(thread_id);
+				if (thread == nullptr)
 					return false;
-				deliver_message(it, message);
+				thread->deliver_message(std::move(message));
+				wake_for_message(thread_id);
 				return true;
 			}
 
 		protected:
 			typename _scheduling_type::iterator getSchedulingFor(_threads_iterator thread) {
-				// Find iterator for scheduling info for this thread
-				auto it = scheduling.cbegin();
-				for (; it != scheduling.cend(); ++it) {
-					const SchedulingInformation &info = *it;
-					// TODO: This deep check should be moved elsewhere
-					if (info.thread_id == thread->second.thread_id) {
-						break;
+				// sleep_until is the time the thread was scheduled for
+				return scheduling.find(SchedulingInformation(thread->first, thread->second.sleep_until));
+			}
+
+			void sample(_threads_iterator thread) {
+				profiling::Profiler::stack_type stack;
+				thread->second.impl->collect_stack(stack);
+				profiler->record("thread " + std::to_string(thread->first), stack);
+			}
+
+			memory::arena_p new_arena() const {
+				if (thread_quota == 0)
+					return memory::arena_p();
+				return memory::Arena::create(thread_quota);
+			}
+
+			// Create a thread in an arena of its own
+			template<class Create>
+			ThreadId insert(Create create) {
+				const ThreadId thread_id = thread_counter++;
+				memory::arena_p arena(new_arena());
+				_thread_type thread = [&arena, &create, thread_id]() {
+					memory::ArenaScope scope(arena.get());
+					return create(thread_id);
+				}();
+				thread.setArena(arena);
+				threads.insert(_threads_ele(thread_id, std::move(thread)));
+				return thread_id;
+			}
+
+			// A thread among the running threads, moving it back there if it
+			// is parked. Only for waking or rescheduling it.
+			_threads_iterator unpark(const ThreadId index) {
+				auto thread = threads.find(index);
+				if (thread != threads.end())
+					return thread;
+				auto it = parked.find(index);
+				if (it == parked.end())
+					return threads.end();
+				thread = threads.emplace(it->first, std::move(it->second)).first;
+				parked.erase(it);
+				return thread;
+			}
+
+			// Wake a thread waiting for the message just delivered to it
+			void wake_for_message(const ThreadId index) {
+				const _thread_type *waiting = getThread(index);
+				if (waiting == nullptr || waiting->wait_state != Message)
+					return;
+				auto thread = unpark(index);
+				thread_remove_scheduling(thread);
+				thread->second.notify_wake();
+			}
+
+#ifdef __linux__
+			// Wake the threads whose fds are ready. When block is set, wait
+			// until one is, or until the next sleeping thread is due.
+			// Returns: the number of threads woken.
+			int poll_io(const bool block) {
+				if (io_waiters.empty())
+					return 0;
+				int timeout = 0;
+				if (block) {
+					timeout = -1;
+					if (!scheduling.empty() && scheduling.begin()->time_point != ThreadTimePoint::max()) {
+						const auto remaining = scheduling.begin()->time_point - ThreadClock::now();
+						// Round up, so as not to wake just short of the deadline
+						const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(remaining).count() + 1;
+						timeout = remaining.count() <= 0 ? 0 : (ms > INT_MAX ? INT_MAX : (int)ms);
+					}
+				}
+				struct epoll_event events[64];
+				const int count = epoll_wait(io_fd, events, 64, timeout);
+				int woken = 0;
+				for (int i = 0; i < count; ++i) {
+					auto waiter = io_waiters.find(events[i].data.fd);
+					if (waiter == io_waiters.end())
+						continue;
+					epoll_ctl(io_fd, EPOLL_CTL_DEL, waiter->first, nullptr);
+					if (wake_fd_waiter(waiter))
+						++woken;
+				}
+				return woken;
+			}
+			// Drop any fd the thread is waiting on
+			void forget_fd_wait(const ThreadId thread_ref) {
+				for (auto it = io_waiters.begin(); it != io_waiters.end(); ++it) {
+					if (it->second == thread_ref) {
+						epoll_ctl(io_fd, EPOLL_CTL_DEL, it->first, nullptr);
+						io_waiters.erase(it);
+						return;
 					}
 				}
-				return it;
 			}
+			// Wake the thread waiting on an fd epoll no longer watches.
+			// Returns: false if the thread no longer exists.
+			bool wake_fd_waiter(std::map<int, ThreadId>::iterator waiter) {
+				const ThreadId thread_ref = waiter->second;
+				io_waiters.erase(waiter);
+				auto thread = unpark(thread_ref);
+				if (thread == threads.end())
+					return false;
+				thread->second.notify_wake();
+				return true;
+			}
+#endif
 
 			// Check if a thread is scheduled to run.
 			bool isThreadScheduled(_threads_iterator thread) {
+				if (thread->second.isParked())
+					return false;
 				// Any scheduling information?
 				if (scheduling.empty())
 					return true;
 
+				// A sleeper that is not yet due needs no lookup
+				ThreadTimePoint now = ThreadClock::now();
+				if (thread->second.sleeping && thread->second.sleep_until > now)
+					return false;
+
 				auto it = getSchedulingFor(thread);
 				// Any scheduling information?
 				if(it == scheduling.end())
 					return true;
 
 				// Check if reached schedule time
-				ThreadTimePoint now = ThreadClock::now();
 				const SchedulingInformation &info = *it;
 
 				if (info.time_point <= now) {
@@ -392,6 +1621,8 @@ namespace stackless {
 					std::cerr << std::endl;
 #endif
 					// Thread has reached schedule time, remove schedule info
+					if (wake_late != nullptr)
+						wake_late->record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - info.time_point).count());
 					scheduling.erase(it);
 					thread->second.notify_wake();
 					return true;
@@ -422,12 +1653,22 @@ namespace stackless {
 			virtual void yield_process(bool unwatched_resolved, int threads_run) {
 			}
 			_threads_type threads;
+			// Threads waiting for a message with no timeout. These are kept
+			// apart so that executeThreads never visits them.
+			_threads_type parked;
+#ifdef __linux__
+			// epoll instance, created on the first wait, and the thread
+			// waiting on each registered fd
+			int io_fd = -1;
+			std::map<int, ThreadId> io_waiters;
+#endif
 			_threads_iterator current_thread;
 			_scheduling_type scheduling;
 			ThreadId thread_counter;
-			void deliver_message(_threads_iterator thread, const _cell_type &message) {
-				thread->second.deliver_message(message);
-			}
+			std::size_t thread_quota = 0;
+			profiling::Profiler *profiler = nullptr;
+			timekeeping::PhaseTimers *timers = nullptr;
+			timekeeping::Histogram *tick_time = nullptr, *slice_time = nullptr, *wake_late = nullptr;
 		};
 
 	}
@@ -449,10 +1690,23 @@ namespace stackless {
 			const FrameType &frame = getCurrentFrame();
 			return frame.isArgumentsResolved() && frame.isResolved();
 		}
+		bool isFrameResolved() {
+			return getCurrentFrame().isResolved();
+		}
 		bool execute() {
 			FrameType &frame = getCurrentFrame();
 			return executeFrame(frame);
 		}
+		// Run up to budget steps, stopping early if the thread blocks or
+		// resolves. The manager calls this once for each time slice, so an
+		// implementation that can run several steps more cheaply than one
+		// at a time may hide it with its own.
+		ExecuteResult executeN(const unsigned budget) {
+			return executeSteps(*this, budget);
+		}
+
+		// Set while the thread sleeps or waits, by the thread itself
+		bool blocked = false;
 
 		virtual FrameType &getCurrentFrame() = 0;
 		virtual bool executeFrame(FrameType &frame) = 0;
@@ -468,23 +1722,69 @@ namespace stackless {
 		virtual void notify_wake() {
 			// Does nothing by default
 		}
-	};
 
+		// Add the names of the calls in progress to stack, outermost first,
+		// for the profiler. Adds nothing by default.
+		virtual void collect_stack(std::vector<std::string> &stack) const {
+		}
 
-	namespace timekeeping {
-		template<typename TimeType, typename ClockType>
-		struct Timekeeper
-		{
-			template<class Callback>
-			static unsigned long long measure(Callback cb) {
-				auto start = ClockType::now();
-				cb();
-				auto end = ClockType::now();
-				return std::chrono::duration_cast<TimeType>(end - start).count();
+	protected:
+		// The step loop for executeN, calling self's execute and
+		// isFrameResolved so that it binds to the most derived of them
+		template<typename Self>
+		static ExecuteResult executeSteps(Self &self, const unsigned budget) {
+			for (unsigned steps = 0; steps < budget; ++steps) {
+				if (self.isFrameResolved())
+					return ExecuteResult{ steps, Resolved };
+				if (self.blocked)
+					return ExecuteResult{ steps, Blocked };
+				self.execute();
 			}
-		};
+			return ExecuteResult{ budget, self.isFrameResolved() ? Resolved : BudgetUsed };
+		}
+	};
+
+	// An Implementation whose steps the manager calls directly instead of
+	// through virtual functions. Derived provides currentFrame() and
+	// runFrame(frame) as plain members. Derived and its frame type should
+	// be final, so that the frame's isResolved is called directly too.
+	// The virtual interface still works for code holding an Implementation.
+	template<typename Derived, typename EnvironmentType, typename FrameType>
+	struct StaticImplementation : public Implementation<EnvironmentType, FrameType> {
+		typedef Implementation<EnvironmentType, FrameType> _base_type;
+		typedef typename _base_type::env_p env_p;
+
+		StaticImplementation(env_p _env) : _base_type(_env) {
+		}
+
+		FrameType &getCurrentFrame() final {
+			return derived().currentFrame();
+		}
+		bool executeFrame(FrameType &frame) final {
+			return derived().runFrame(frame);
+		}
+
+		// These hide the Implementation versions, which make virtual calls
+		bool isResolved() {
+			const FrameType &frame = derived().currentFrame();
+			return frame.isArgumentsResolved() && frame.isResolved();
+		}
+		bool isFrameResolved() {
+			return derived().currentFrame().isResolved();
+		}
+		bool execute() {
+			Derived &self = derived();
+			return self.runFrame(self.currentFrame());
+		}
+		ExecuteResult executeN(const unsigned budget) {
+			return _base_type::executeSteps(*this, budget);
+		}
+
+	private:
+		Derived &derived() {
+			return static_cast<Derived &>(*this);
+		}
+	};
 
-		typedef Timekeeper<typename std::chrono::milliseconds, typename std::chrono::steady_clock> StacklessTimekeeper;
-	}
 }
 
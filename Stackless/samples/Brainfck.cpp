@@ -1,16 +1,37 @@
 #include "stdafx.h"
 
+#include <algorithm>
 #include <assert.h>
+#include <atomic>
 #include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <exception>
+#include <fstream>
 #include <list>
+#include <map>
 #include <memory>
+#include <sstream>
+#include <stdexcept>
 #include <stdio.h>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <vector>
 
 #include <iostream>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define BF_MAPPED_TAPE
+#endif
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
 const bool verbose = false;
 
 using namespace stackless;
@@ -32,6 +53,27 @@ enum BFOperations {
 	CellRead = ',',
 };
 
+// Instructions the source is compiled to. Runs of + - > < are folded into one
+// instruction with a count, and common loops into single instructions.
+enum BFOpcode : uint8_t {
+	OpAdd,     // add arg to the current cell
+	OpMove,    // move the pointer by arg
+	OpClear,   // [-]: set the current cell to 0
+	OpMulAdd,  // add arg times the current cell to the cell at offset
+	OpScan,    // [>] or [<]: step by arg until a zero cell
+	OpOpen,    // [: jump to arg when the current cell is 0
+	OpClose,   // ]: jump to arg unless the current cell is 0
+	OpPrint,
+	OpRead,
+	OpCount,   // the number of opcodes
+};
+
+struct BFInstruction {
+	BFOpcode op;
+	int32_t arg;
+	int32_t offset;
+};
+
 typedef char BFCell;
 typedef std::vector<BFCell> BFList;
 typedef BFList::iterator BFList_iterator;
@@ -39,6 +81,182 @@ typedef BFList::const_iterator BFList_const_iterator;
 
 // Must be a power of 2
 const size_t BFMEMSIZE = 1 << 15; // 32768
+// Cells a growable tape starts with. Must be a power of 2
+const size_t BFGROWSIZE = 1 << 12; // 4096
+// Loop iterations a thread runs each cycle before yielding
+const unsigned BFLOOPBUDGET = 64;
+
+// Where a thread's output goes. Characters are buffered and written in
+// batches when the buffer fills, and flushed through to the device when the
+// thread finishes and before it waits for input.
+struct BFOutput {
+	virtual ~BFOutput() {
+	}
+	void put(const char ch) {
+		buffer.push_back(ch);
+		if (buffer.size() >= capacity)
+			drain();
+	}
+	void flush() {
+		drain();
+		sync();
+	}
+protected:
+	virtual void write(const char *data, size_t size) = 0;
+	// Push what has been written on to the device
+	virtual void sync() {
+	}
+private:
+	void drain() {
+		if (buffer.empty())
+			return;
+		write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+	static const size_t capacity = 4096;
+	std::string buffer;
+};
+
+struct BFStreamOutput : public BFOutput {
+	BFStreamOutput(std::ostream &stream) : stream(stream) {
+	}
+	~BFStreamOutput() {
+		flush();
+	}
+protected:
+	void write(const char *data, size_t size) {
+		stream.write(data, size);
+	}
+	void sync() {
+		stream.flush();
+	}
+private:
+	std::ostream &stream;
+};
+
+struct BFFileOutput : public BFOutput {
+	BFFileOutput(const std::string &path) : file(path, std::ios::binary | std::ios::trunc) {
+		if (!file)
+			throw std::runtime_error("cannot open " + path);
+	}
+	~BFFileOutput() {
+		flush();
+	}
+protected:
+	void write(const char *data, size_t size) {
+		file.write(data, size);
+	}
+private:
+	std::ofstream file;
+};
+
+// Collects output in memory
+struct BFMemoryOutput : public BFOutput {
+	// Everything written so far
+	const std::string &str() {
+		flush();
+		return contents;
+	}
+protected:
+	void write(const char *data, size_t size) {
+		contents.append(data, size);
+	}
+private:
+	std::string contents;
+};
+
+// Where a thread's input comes from, read in batches
+struct BFInput {
+	virtual ~BFInput() {
+	}
+	// Whether a character can be had without reading more
+	bool ready() const {
+		return pos < buffer.size();
+	}
+	// Returns: false at the end of input
+	bool get(char &ch) {
+		if (!ready()) {
+			buffer.resize(capacity);
+			buffer.resize(read(&buffer[0], capacity));
+			pos = 0;
+			if (buffer.empty())
+				return false;
+		}
+		ch = buffer[pos++];
+		return true;
+	}
+protected:
+	// Read up to size characters. Returns: the number read, 0 at the end.
+	virtual size_t read(char *data, size_t size) = 0;
+private:
+	static const size_t capacity = 4096;
+	std::string buffer;
+	size_t pos = 0;
+};
+
+struct BFStreamInput : public BFInput {
+	BFStreamInput(std::istream &stream) : stream(stream) {
+	}
+protected:
+	size_t read(char *data, size_t size) {
+		// Wait for one character, then take whatever else is to hand, so
+		// that interactive input is not held up waiting for a full batch
+		if (!stream.read(data, 1))
+			return 0;
+		return 1 + (size_t)stream.readsome(data + 1, size - 1);
+	}
+private:
+	std::istream &stream;
+};
+
+struct BFFileInput : public BFInput {
+	BFFileInput(const std::string &path) : file(path, std::ios::binary) {
+		if (!file)
+			throw std::runtime_error("cannot open " + path);
+	}
+protected:
+	size_t read(char *data, size_t size) {
+		file.read(data, size);
+		return (size_t)file.gcount();
+	}
+private:
+	std::ifstream file;
+};
+
+struct BFMemoryInput : public BFInput {
+	BFMemoryInput(const std::string &contents) : contents(contents) {
+	}
+protected:
+	size_t read(char *data, size_t size) {
+		const size_t count = std::min(size, contents.size() - offset);
+		memcpy(data, contents.data() + offset, count);
+		offset += count;
+		return count;
+	}
+private:
+	const std::string contents;
+	size_t offset = 0;
+};
+
+// What , stores at the end of input. Programs differ in what they expect.
+enum BFEndOfInput {
+	EofZero,
+	EofMinusOne,
+	EofUnchanged,
+};
+
+// How a frame dispatches instructions. All behave the same; they differ
+// only in speed.
+enum BFDispatchMode {
+	DispatchBySwitch,  // a switch over the opcode
+	DispatchByTable,   // a table of handlers built at compile time
+	DispatchThreaded,  // computed goto from each handler to the next
+};
+#ifdef STACKLESS_COMPUTED_GOTO
+const BFDispatchMode BFDISPATCH = DispatchThreaded;
+#else
+const BFDispatchMode BFDISPATCH = DispatchByTable;
+#endif
 
 //typedef InstructionConverter<BFCell, BFOperations> BFInstructionConverter;
 struct BFInstructionConverter : public InstructionConverter<BFCell, BFOperations> {
@@ -47,32 +265,259 @@ struct BFInstructionConverter : public InstructionConverter<BFCell, BFOperations
 	}
 };
 
-struct BFEnvironment : public Environment<BFList> {
-	typedef std::shared_ptr<BFEnvironment> env_p;
+// A compiled program. It does not change once built, so any number of
+// environments can share one.
+struct BFProgram {
+	typedef std::vector<BFOperations> code_type;
+	typedef std::vector<BFInstruction> program_type;
+	typedef program_type::size_type size_type;
+
+	// Compile source, throwing std::runtime_error if its brackets do not
+	// balance.
+	template<typename ListType>
+	BFProgram(const ListType &data) {
+		code_type code;
+		for (auto datptr = data.begin(); datptr != data.end(); ++datptr) {
+			const char ch = *datptr;
+			code.push_back(BFInstructionConverter::convert(ch));
+		}
+		compile(code);
+		program.shrink_to_fit();
+	}
+
+	size_type size() const {
+		return program.size();
+	}
+	const BFInstruction &operator[] (const size_type index) const {
+		return program[index];
+	}
+
+private:
+	// Execution stops at the end of code or at a 0 character
+	void compile(const code_type &code) {
+		// program index and code position of each unclosed [
+		std::vector<std::pair<typename program_type::size_type, typename code_type::size_type>> open;
+		for (typename code_type::size_type pos = 0; pos < code.size() && code[pos] != 0; ++pos) {
+			switch (code[pos]) {
+			case CellIncrement:
+			case CellDecrement:
+				emitRun(OpAdd, code[pos] == CellIncrement ? 1 : -1);
+				break;
+			case CellRight:
+			case CellLeft:
+				emitRun(OpMove, code[pos] == CellRight ? 1 : -1);
+				break;
+			case CellPrint:
+				program.push_back(BFInstruction{ OpPrint, 0, 0 });
+				break;
+			case CellRead:
+				program.push_back(BFInstruction{ OpRead, 0, 0 });
+				break;
+			case CellWhile:
+				open.push_back(std::make_pair(program.size(), pos));
+				program.push_back(BFInstruction{ OpOpen, 0, 0 });
+				break;
+			case CellEndWhile: {
+				if (open.empty())
+					throw std::runtime_error("unmatched ] at position " + std::to_string(pos));
+				const typename program_type::size_type start = open.back().first;
+				open.pop_back();
+				if (!foldLoop(start)) {
+					// Each jump lands just past its partner
+					program[start].arg = (int32_t)program.size() + 1;
+					program.push_back(BFInstruction{ OpClose, (int32_t)start + 1, 0 });
+				}
+				break;
+			}
+			default:
+				// Anything else is a comment
+				break;
+			}
+		}
+		if (!open.empty())
+			throw std::runtime_error("unmatched [ at position " + std::to_string(open.back().second));
+	}
+
+	// Fold an add or move into the previous one where possible
+	void emitRun(const BFOpcode op, const int32_t amount) {
+		if (!program.empty() && program.back().op == op) {
+			program.back().arg += amount;
+			if (program.back().arg == 0)
+				program.pop_back();
+			return;
+		}
+		program.push_back(BFInstruction{ op, amount, 0 });
+	}
+
+	// Replace the loop opened at start, whose body is the rest of program,
+	// with an equivalent instruction sequence. Returns: false if the loop is
+	// not one that can be replaced.
+	bool foldLoop(const typename program_type::size_type start) {
+		const typename program_type::size_type body = start + 1, length = program.size() - body;
+		if (length == 1 && program[body].op == OpAdd && (program[body].arg & 1)) {
+			// [-], [+], or any odd step reaches 0
+			program.resize(start);
+			program.push_back(BFInstruction{ OpClear, 0, 0 });
+			return true;
+		}
+		if (length == 1 && program[body].op == OpMove) {
+			const int32_t step = program[body].arg;
+			program.resize(start);
+			program.push_back(BFInstruction{ OpScan, step, 0 });
+			return true;
+		}
+		// A body of adds and moves that returns to where it started, and
+		// takes one from the starting cell, adds a multiple of that cell
+		// to each other cell it touches: [->++>+++<<]
+		std::map<int32_t, int32_t> adds;
+		int32_t offset = 0;
+		for (typename program_type::size_type i = body; i < program.size(); ++i) {
+			if (program[i].op == OpMove)
+				offset += program[i].arg;
+			else if (program[i].op == OpAdd)
+				adds[offset] += program[i].arg;
+			else
+				return false;
+		}
+		if (offset != 0 || adds[0] != -1)
+			return false;
+		program.resize(start);
+		for (const auto &add : adds)
+			if (add.first != 0 && add.second != 0)
+				program.push_back(BFInstruction{ OpMulAdd, add.second, add.first });
+		program.push_back(BFInstruction{ OpClear, 0, 0 });
+		return true;
+	}
+
+	program_type program;
+};
+typedef std::shared_ptr<const BFProgram> BFProgram_p;
+
+// Standard output and input, shared by every environment not given its own
+std::shared_ptr<BFOutput> BFStandardOutput() {
+	static std::shared_ptr<BFOutput> output(new BFStreamOutput(std::cout));
+	return output;
+}
+std::shared_ptr<BFInput> BFStandardInput() {
+	static std::shared_ptr<BFInput> input(new BFStreamInput(std::cin));
+	return input;
+}
+
+// How a tape handles the pointer leaving it
+enum BFTapeMode {
+	TapeWrap,  // fixed size; the pointer wraps around at either end
+	TapeGrow,  // starts at BFGROWSIZE cells and doubles, up to its full
+	           // size, when the pointer moves past the right end. Moving
+	           // left of the first cell wraps to the current end.
+};
+
+// Storage for a tape. Where anonymous mappings are available the tape is
+// mapped rather than allocated, so a page costs nothing until a cell in it is
+// written; elsewhere it is zeroed with calloc.
+template<typename CellType>
+struct BFTape {
+	explicit BFTape(const std::size_t cells) : cells(cells), base(map(cells)) {
+	}
+	BFTape(const BFTape &) = delete;
+	BFTape &operator= (const BFTape &) = delete;
+	~BFTape() {
+		unmap(base, cells);
+	}
+
+	// Enlarge to new_cells, keeping the contents. New cells are zero.
+	void resize(const std::size_t new_cells) {
+#if defined(BF_MAPPED_TAPE) && defined(__linux__)
+		void *moved = mremap(base, bytes(cells), bytes(new_cells), MREMAP_MAYMOVE);
+		if (moved == MAP_FAILED)
+			throw std::bad_alloc();
+		base = static_cast<CellType *>(moved);
+#else
+		CellType *grown = map(new_cells);
+		memcpy(grown, base, bytes(cells));
+		unmap(base, cells);
+		base = grown;
+#endif
+		cells = new_cells;
+	}
+
+	std::size_t size() const {
+		return cells;
+	}
+	CellType *data() {
+		return base;
+	}
+	const CellType *data() const {
+		return base;
+	}
+	CellType &operator[] (const std::size_t index) {
+		return base[index];
+	}
+	const CellType &operator[] (const std::size_t index) const {
+		return base[index];
+	}
+
+private:
+	static std::size_t bytes(const std::size_t cells) {
+		return cells * sizeof(CellType);
+	}
+	static CellType *map(const std::size_t cells) {
+#ifdef BF_MAPPED_TAPE
+		void *memory = mmap(nullptr, bytes(cells), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (memory == MAP_FAILED)
+			throw std::bad_alloc();
+#else
+		void *memory = calloc(cells, sizeof(CellType));
+		if (memory == nullptr)
+			throw std::bad_alloc();
+#endif
+		return static_cast<CellType *>(memory);
+	}
+	static void unmap(CellType *memory, const std::size_t cells) {
+#ifdef BF_MAPPED_TAPE
+		munmap(memory, bytes(cells));
+#else
+		free(memory);
+#endif
+	}
+
+	std::size_t cells;
+	CellType *base;
+};
+
+// An environment whose cells are CellType: char, uint16_t or uint32_t.
+template<typename CellType>
+struct BasicBFEnvironment : public Environment<std::vector<CellType>> {
+	typedef typename Environment<std::vector<CellType>>::_size_type _size_type;
+	typedef std::shared_ptr<BasicBFEnvironment> env_p;
 	typedef env_p _env_p;
 
-	BFEnvironment(env_p outer = nullptr, const typename BFList::size_type memsize = BFMEMSIZE)
-	: _outer(outer), tape(memsize), _memsize_max(memsize - 1)
+	// memsize is the size of the tape in cells; in TapeGrow mode, the size it
+	// may grow to.
+	BasicBFEnvironment(env_p outer = nullptr, const _size_type memsize = BFMEMSIZE, const BFTapeMode mode = TapeWrap)
+	: tape(mode == TapeGrow ? std::min(memsize, BFGROWSIZE) : memsize),
+	  output(BFStandardOutput()), input(BFStandardInput()),
+	  _outer(outer), _memsize_max(tape.size() - 1), _memsize_limit(memsize), _mode(mode)
 	{
 		assert(("memsize must be greater than 0", memsize != 0));
 		// Ensure memsize is a power of 2
 		assert(("memsize must be a power of 2", 0 == (memsize & (memsize - 1))));
 	}
 
-	BFList_iterator begin() { return tape.begin(); }
-	BFList_const_iterator cbegin() const { return tape.cbegin(); }
-	BFList_iterator end() { return tape.end(); }
-	BFList_const_iterator cend() const { return tape.cend(); }
-
-	typedef std::vector<BFOperations> code_type;
+	CellType *begin() { return tape.data(); }
+	const CellType *cbegin() const { return tape.data(); }
+	CellType *end() { return tape.data() + tape.size(); }
+	const CellType *cend() const { return tape.data() + tape.size(); }
 
+	// Compile and load a program of this environment's own, throwing
+	// std::runtime_error if its brackets do not balance.
 	template<typename ListType>
-	void assignCode(ListType data) {
-		typename ListType::iterator datptr = data.begin();
-		for (; datptr != data.end(); ++datptr) {
-			const char ch = *datptr;
-			code.push_back((BFOperations)ch);
-		}
+	void assignCode(const ListType &data) {
+		assignProgram(std::make_shared<const BFProgram>(data));
+	}
+	// Load a program, which may be shared with other environments
+	void assignProgram(BFProgram_p compiled) {
+		program = compiled;
+		ip = 0;
 	}
 
 	_size_type ipValue() const {
@@ -89,41 +534,123 @@ struct BFEnvironment : public Environment<BFList> {
 		return pos & _memsize_max;
 	}
 
+	// Index of the cell delta away from pos, growing the tape to reach it
+	// if need be.
+	_size_type advance(const _size_type pos, const int32_t delta) {
+		const _size_type next = pos + delta;
+		if (next <= _memsize_max)
+			return next;
+		if (delta > 0 && growable()) {
+			const _size_type target = next & (_memsize_limit - 1);
+			if (target > _memsize_max)
+				grow(target);
+			return target;
+		}
+		return wrap(next);
+	}
+
 	_size_type mem_size() const {
 		return _memsize_max + 1;
 	}
-	typename code_type::size_type code_size() const {
-		return code.size();
+	BFProgram::size_type program_size() const {
+		return program->size();
+	}
+
+	// Find the nearest zero cell from pos, stepping by step and wrapping
+	// around the tape. Returns: false if there is none.
+	bool scan(_size_type &pos, const int32_t step) {
+		const CellType *base = tape.data();
+		const _size_type size = mem_size();
+		if (step == 1 && sizeof(CellType) == 1) {
+			const void *hit = memchr(base + pos, 0, size - pos);
+			if (hit == nullptr && growable()) {
+				// Cells past the end are zero
+				pos = size;
+				grow(pos);
+				return true;
+			}
+			if (hit == nullptr)
+				hit = memchr(base, 0, pos);
+			if (hit == nullptr)
+				return false;
+			pos = static_cast<const CellType *>(hit) - base;
+			return true;
+		}
+#ifdef __GLIBC__
+		if (step == -1 && sizeof(CellType) == 1) {
+			const void *hit = memrchr(base, 0, pos + 1);
+			if (hit == nullptr)
+				hit = memrchr(base + pos + 1, 0, size - pos - 1);
+			if (hit == nullptr)
+				return false;
+			pos = static_cast<const CellType *>(hit) - base;
+			return true;
+		}
+#endif
+		for (_size_type n = 0; n < _memsize_limit; ++n, pos = advance(pos, step))
+			if (tape[pos] == 0)
+				return true;
+		return false;
 	}
 
-	BFList tape;
-	code_type code;
+	BFTape<CellType> tape;
+	// the program being run; ip indexes this
+	BFProgram_p program;
+	// stdout and stdin unless replaced
+	std::shared_ptr<BFOutput> output;
+	std::shared_ptr<BFInput> input;
+	BFEndOfInput end_of_input = EofZero;
+	BFDispatchMode dispatch_mode = BFDISPATCH;
+	// instructions dispatched so far
+	uint64_t executed = 0;
 
 private:
+	bool growable() const {
+		return _mode == TapeGrow && _memsize_max + 1 < _memsize_limit;
+	}
+	// Double the tape until pos is on it
+	void grow(const _size_type pos) {
+		_size_type size = mem_size();
+		while (size <= pos)
+			size *= 2;
+		tape.resize(size);
+		_memsize_max = size - 1;
+	}
+
 	env_p _outer;
 	_size_type _memsize_max;
+	_size_type _memsize_limit;
+	BFTapeMode _mode;
 
 };
 
-// An unused arguments type
-typedef unsigned BFArgs;
-typedef unsigned BFArgsSize;
+template<typename CellType>
+struct BasicBFFrame final : public Frame<CellType, BFOpcode, BasicBFEnvironment<CellType>> {
+	typedef Frame<CellType, BFOpcode, BasicBFEnvironment<CellType>> BFStacklessFrame;
+	typedef typename BFStacklessFrame::env_p env_p;
+	using BFStacklessFrame::env;
 
-typedef Frame<BFCell, BFOperations, BFEnvironment> BFStacklessFrame;
-
-struct BFFrame : public BFStacklessFrame {
-	BFFrame(env_p environment) : BFStacklessFrame(environment) {}
+	BasicBFFrame(env_p environment) : BFStacklessFrame(environment) {}
 	void execute() {
 		dispatch();
 	}
 	void dispatch();
+	// Run until resolved, or until budget backward jumps have been taken.
+	// Straight-line code runs through, so threads yield at loop back-edges.
+	// A budget of 0 runs nothing.
+	// Returns: the number of backward jumps taken.
+	unsigned run(unsigned budget);
+	template<void (*Dispatch)(BasicBFFrame &)>
+	unsigned runLoop(unsigned budget);
+#ifdef STACKLESS_COMPUTED_GOTO
+	unsigned runThreaded(unsigned budget);
+#endif
 	// Fetch current instruction
-	BFOperations fetch() {
-		return BFInstructionConverter::convert(env->code[env->ip]);
+	const BFInstruction &fetch() const {
+		return (*env->program)[env->ip];
 	}
 	bool isResolved() const {
-		// Execution stops if *ip = 0
-		return env->ip == env->code_size() || env->code[env->ip] == 0;
+		return env->ip == env->program_size();
 	}
 	bool isArgumentsResolved() const {
 		// This frame has no arguments
@@ -131,126 +658,287 @@ struct BFFrame : public BFStacklessFrame {
 	}
 };
 
-struct BFImplementation : public Implementation<BFEnvironment,BFFrame> {
+template<typename CellType>
+struct BasicBFImplementation final : public StaticImplementation<BasicBFImplementation<CellType>, BasicBFEnvironment<CellType>, BasicBFFrame<CellType>> {
+	typedef BasicBFFrame<CellType> BFFrameType;
+	typedef StaticImplementation<BasicBFImplementation, BasicBFEnvironment<CellType>, BFFrameType> BFStacklessImplementation;
+	typedef typename BFStacklessImplementation::env_p env_p;
+
 	// Create the single frame we'll reuse throughout execution
-	BFImplementation(env_p _env) : Implementation(_env), frame(BFFrame(_env)) {
+	BasicBFImplementation(env_p _env, const unsigned loop_budget = BFLOOPBUDGET)
+		: BFStacklessImplementation(_env), frame(BFFrameType(_env)), loop_budget(loop_budget) {
+		if (loop_budget == 0)
+			throw std::invalid_argument("loop budget must be greater than 0");
 	}
-	BFFrame &getCurrentFrame() {
+	BFFrameType &currentFrame() {
 		return frame;
 	}
-	bool executeFrame(BFFrame &frame) {
-		frame.dispatch();
+	bool runFrame(BFFrameType &frame) {
+		frame.run(loop_budget);
 		return true;
 	}
+	// A step is loop_budget backward jumps, so a whole slice of steps is
+	// one run of the frame
+	ExecuteResult executeN(const unsigned budget) {
+		if (frame.isResolved())
+			return ExecuteResult{ 0, Resolved };
+		if (budget == 0)
+			return ExecuteResult{ 0, BudgetUsed };
+		const unsigned long long jumps = (unsigned long long)budget * loop_budget;
+		const unsigned taken = frame.run(jumps > UINT_MAX ? UINT_MAX : (unsigned)jumps);
+		const unsigned steps = std::max(1u, (taken + loop_budget - 1) / loop_budget);
+		return ExecuteResult{ steps, frame.isResolved() ? Resolved : BudgetUsed };
+	}
 private:
-	BFFrame frame;
+	BFFrameType frame;
+	const unsigned loop_budget;
 };
 
 // Unimplemented opcode handler
-template<BFOperations Operation> struct BFDispatcher {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		if (verbose) std::cerr << "Unimplemented opcode: " << (char)frame.env->ip << "\n";
-		throw stackless::InvalidOperation<BFOperations, int, BFArgs>(Operation, 0, args);
+template<BFOpcode Operation, typename CellType> struct BFDispatcher {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		if (verbose) std::cerr << "Unimplemented opcode: " << (int)ins.op << "\n";
+		throw stackless::InvalidOperation<BFOpcode, int, int32_t>(Operation, 0, ins.arg);
+	}
+};
+template<typename CellType> struct BFDispatcher<OpAdd, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		frame.env->tape[frame.env->mp] += (CellType)ins.arg;
+		if(verbose) std::cerr << "+ success, *mp=" << (int)frame.env->tape[frame.env->mp] << "\n";
 	}
 };
-template<> struct BFDispatcher<CellRight> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		++frame.env->mp;
+template<typename CellType> struct BFDispatcher<OpMove, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		frame.env->mp = frame.env->advance(frame.env->mp, ins.arg);
 		if(verbose) std::cerr << "> success, mp=" << frame.env->mp << "\n";
 	}
 };
-template<> struct BFDispatcher<CellLeft> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		--frame.env->mp;
-		if(verbose) std::cerr << "< success, mp=" << frame.env->mp << "\n";
+template<typename CellType> struct BFDispatcher<OpClear, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		frame.env->tape[frame.env->mp] = 0;
 	}
 };
-template<> struct BFDispatcher<CellIncrement> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		++frame.env->tape[frame.env->mp];
-		if(verbose) std::cerr << "+ success, *mp=" << (int)frame.env->tape[frame.env->mp] << "\n";
+template<typename CellType> struct BFDispatcher<OpMulAdd, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		BasicBFEnvironment<CellType> &env = *frame.env;
+		const CellType amount = (CellType)(env.tape[env.mp] * ins.arg);
+		env.tape[env.advance(env.mp, ins.offset)] += amount;
 	}
 };
-template<> struct BFDispatcher<CellDecrement> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		--frame.env->tape[frame.env->mp];
-		if(verbose) std::cerr << "- success, *mp=" << (int)frame.env->tape[frame.env->mp] << "\n";
+template<typename CellType> struct BFDispatcher<OpScan, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		// With no zero cell the loop never ends; stay on it, yielding as usual
+		if (!frame.env->scan(frame.env->mp, ins.arg))
+			--frame.env->ip;
+		if(verbose) std::cerr << "scan success, mp=" << frame.env->mp << "\n";
 	}
 };
-template<> struct BFDispatcher<CellPrint> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		std::cout << (char)frame.env->tape[frame.env->mp];
+template<typename CellType> struct BFDispatcher<OpPrint, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		// Wider cells print their low byte
+		frame.env->output->put((char)frame.env->tape[frame.env->mp]);
 	}
 };
-template<> struct BFDispatcher<CellWhile> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		if (frame.env->tape[frame.env->mp] == 0) {
-			unsigned nesting = 1;
-			while (nesting > 0) {
-				const BFCell &ch = frame.env->code[++frame.env->ip];
-				if (ch == CellWhile) ++nesting;
-				else if (ch == CellEndWhile) --nesting;
-			}
-		}
+template<typename CellType> struct BFDispatcher<OpRead, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		// Show any prompt before waiting
+		if (!frame.env->input->ready())
+			frame.env->output->flush();
+		char ch;
+		if (frame.env->input->get(ch))
+			frame.env->tape[frame.env->mp] = (CellType)(unsigned char)ch;
+		else if (frame.env->end_of_input != EofUnchanged)
+			frame.env->tape[frame.env->mp] = frame.env->end_of_input == EofZero ? 0 : (CellType)-1;
+	}
+};
+template<typename CellType> struct BFDispatcher<OpOpen, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		if (frame.env->tape[frame.env->mp] == 0)
+			frame.env->ip = ins.arg;
 		if(verbose) std::cerr << "[ success, mp=" << frame.env->mp << "\n";
 	}
 };
-template<> struct BFDispatcher<CellEndWhile> {
-	static void dispatch(BFFrame &frame, BFArgs &args) {
-		if (frame.env->tape[frame.env->mp] != 0) {
-			unsigned nesting = 1;
-			--frame.env->ip;
-			while (nesting > 0) {
-				const BFCell &ch = frame.env->code[--frame.env->ip];
-				if (ch == CellEndWhile) ++nesting;
-				else if (ch == CellWhile) --nesting;
-			}
-		}
+template<typename CellType> struct BFDispatcher<OpClose, CellType> {
+	static void dispatch(BasicBFFrame<CellType> &frame, const BFInstruction &ins) {
+		if (frame.env->tape[frame.env->mp] != 0)
+			frame.env->ip = ins.arg;
 		if(verbose) std::cerr << "] success, *mp=" << frame.env->mp << "\n";
 	}
 };
 
+template<typename CellType>
 struct BFFrameDispatcher {
-	static void dispatch(BFFrame &frame, BFArgsSize argsSize, BFArgs &args) {
+	template<BFOpcode Operation> using Dispatcher = BFDispatcher<Operation, CellType>;
+	typedef DispatchTable<BFOpcode, Dispatcher, OpCount, void, BasicBFFrame<CellType> &, const BFInstruction &> Table;
+
+	static void dispatch(BasicBFFrame<CellType> &frame) {
 		// Master dispatcher
-		const BFOperations operation = frame.fetch();
-		
-		if(verbose) std::cerr << "Fetch at " << frame.env->ipValue() << " = " << operation << ", mp = " << frame.env->mpValue() << "\n";
+		const BFInstruction &instruction = frame.fetch();
+
+		if(verbose) std::cerr << "Fetch at " << frame.env->ipValue() << " = " << (int)instruction.op << ", mp = " << frame.env->mpValue() << "\n";
 
-		const BFOperations &instruction = frame.fetch();
 		++frame.env->ip;
+		Table::dispatch(instruction.op, frame, instruction);
+	}
 
-		switch (instruction) {
-		case CellRight:
-			return BFDispatcher<CellRight>::dispatch(frame, args);
-		case CellLeft:
-			return BFDispatcher<CellLeft>::dispatch(frame, args);
-		case CellIncrement:
-			return BFDispatcher<CellIncrement>::dispatch(frame, args);
-		case CellDecrement:
-			return BFDispatcher<CellDecrement>::dispatch(frame, args);
-		case CellWhile:
-			return BFDispatcher<CellWhile>::dispatch(frame, args);
-		case CellEndWhile:
-			return BFDispatcher<CellEndWhile>::dispatch(frame, args);
-		case CellPrint:
-			return BFDispatcher<CellPrint>::dispatch(frame, args);
-		case CellRead:
-			return BFDispatcher<CellRead>::dispatch(frame, args);
-		default:
-			// Do nothing, as per BF rules
-			break;
+	// The same by a hand-written switch, kept to compare against
+	static void dispatchSwitch(BasicBFFrame<CellType> &frame) {
+		const BFInstruction &instruction = frame.fetch();
+		++frame.env->ip;
+
+		switch (instruction.op) {
+		case OpAdd:
+			return BFDispatcher<OpAdd, CellType>::dispatch(frame, instruction);
+		case OpMove:
+			return BFDispatcher<OpMove, CellType>::dispatch(frame, instruction);
+		case OpClear:
+			return BFDispatcher<OpClear, CellType>::dispatch(frame, instruction);
+		case OpMulAdd:
+			return BFDispatcher<OpMulAdd, CellType>::dispatch(frame, instruction);
+		case OpScan:
+			return BFDispatcher<OpScan, CellType>::dispatch(frame, instruction);
+		case OpOpen:
+			return BFDispatcher<OpOpen, CellType>::dispatch(frame, instruction);
+		case OpClose:
+			return BFDispatcher<OpClose, CellType>::dispatch(frame, instruction);
+		case OpPrint:
+			return BFDispatcher<OpPrint, CellType>::dispatch(frame, instruction);
+		case OpRead:
+			return BFDispatcher<OpRead, CellType>::dispatch(frame, instruction);
+		case OpCount:
+			return BFDispatcher<OpCount, CellType>::dispatch(frame, instruction);
 		}
 	}
 };
 
-void BFFrame::dispatch() {
-	static BFArgsSize argsSize = 0;
-	static BFArgs args = 0;
-	BFFrameDispatcher::dispatch(*this, argsSize, args);
+template<typename CellType>
+void BasicBFFrame<CellType>::dispatch() {
+	// The manager may keep stepping a thread for the rest of its cycles
+	if (isResolved())
+		return;
+	BFFrameDispatcher<CellType>::dispatch(*this);
+}
+
+template<typename CellType>
+unsigned BasicBFFrame<CellType>::run(unsigned budget) {
+	// Both loops count the budget down before testing it
+	if (budget == 0)
+		return 0;
+	unsigned taken;
+	switch (env->dispatch_mode) {
+	case DispatchBySwitch:
+		taken = runLoop<&BFFrameDispatcher<CellType>::dispatchSwitch>(budget);
+		break;
+#ifdef STACKLESS_COMPUTED_GOTO
+	case DispatchThreaded:
+		taken = runThreaded(budget);
+		break;
+#endif
+	default:
+		taken = runLoop<&BFFrameDispatcher<CellType>::dispatch>(budget);
+		break;
+	}
+	if (isResolved())
+		env->output->flush();
+	return taken;
+}
+
+template<typename CellType>
+template<void (*Dispatch)(BasicBFFrame<CellType> &)>
+unsigned BasicBFFrame<CellType>::runLoop(unsigned budget) {
+	const unsigned initial = budget;
+	uint64_t executed = 0;
+	while (!isResolved()) {
+		const typename BasicBFEnvironment<CellType>::_size_type from = env->ip;
+		Dispatch(*this);
+		++executed;
+		if (env->ip <= from && --budget == 0)
+			break;
+	}
+	env->executed += executed;
+	return initial - budget;
+}
+
+#ifdef STACKLESS_COMPUTED_GOTO
+// Each handler jumps straight to the next instruction's handler, rather
+// than returning to a loop with a single indirect jump for all of them.
+// Only OpScan and OpClose can jump back, so only they count the budget.
+template<typename CellType>
+unsigned BasicBFFrame<CellType>::runThreaded(unsigned budget) {
+	// In BFOpcode order
+	static void *const labels[] = {
+		&&op_add, &&op_move, &&op_clear, &&op_muladd, &&op_scan,
+		&&op_open, &&op_close, &&op_print, &&op_read,
+	};
+	static_assert(sizeof(labels) / sizeof(labels[0]) == OpCount, "a label for every opcode");
+
+	const unsigned initial = budget;
+	BasicBFEnvironment<CellType> &environment = *env;
+	const BFProgram &program = *environment.program;
+	const BFProgram::size_type size = program.size();
+	const BFInstruction *ins;
+	uint64_t executed = 0;
+#define BF_NEXT() \
+	do { \
+		if (environment.ip == size) goto done; \
+		ins = &program[environment.ip++]; \
+		++executed; \
+		goto *labels[ins->op]; \
+	} while (0)
+#define BF_NEXT_COUNTED(from) \
+	do { \
+		if (environment.ip <= (from) && --budget == 0) goto done; \
+		BF_NEXT(); \
+	} while (0)
+
+	BF_NEXT();
+op_add:
+	BFDispatcher<OpAdd, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+op_move:
+	BFDispatcher<OpMove, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+op_clear:
+	BFDispatcher<OpClear, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+op_muladd:
+	BFDispatcher<OpMulAdd, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+op_scan:
+	BFDispatcher<OpScan, CellType>::dispatch(*this, *ins);
+	BF_NEXT_COUNTED(BFProgram::size_type(ins - &program[0]));
+op_open:
+	BFDispatcher<OpOpen, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+op_close:
+	BFDispatcher<OpClose, CellType>::dispatch(*this, *ins);
+	BF_NEXT_COUNTED(BFProgram::size_type(ins - &program[0]));
+op_print:
+	BFDispatcher<OpPrint, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+op_read:
+	BFDispatcher<OpRead, CellType>::dispatch(*this, *ins);
+	BF_NEXT();
+done:
+	environment.executed += executed;
+	return initial - budget;
+#undef BF_NEXT_COUNTED
+#undef BF_NEXT
 }
+#endif
 
+// 8-bit cells, the usual choice
+typedef BasicBFEnvironment<BFCell> BFEnvironment;
+typedef BasicBFFrame<BFCell> BFFrame;
+typedef BasicBFImplementation<BFCell> BFImplementation;
 typedef MicrothreadManager<BFImplementation> BFMicrothreadManager;
+// Wider cells, for programs that expect them
+typedef BasicBFEnvironment<uint16_t> BFEnvironment16;
+typedef BasicBFImplementation<uint16_t> BFImplementation16;
+typedef MicrothreadManager<BFImplementation16> BFMicrothreadManager16;
+typedef BasicBFEnvironment<uint32_t> BFEnvironment32;
+typedef BasicBFImplementation<uint32_t> BFImplementation32;
+typedef MicrothreadManager<BFImplementation32> BFMicrothreadManager32;
 
 void BFTest() {
 	// Hello world application
@@ -293,11 +981,12 @@ void BFTest() {
 	BFMicrothreadManager manager;
 
 	auto duration = StacklessTimekeeper::measure([&manager, &hello_world]() {
-		// Create a few different instances
+		// Create a few different instances, all running one compiled program
+		BFProgram_p program(new BFProgram(hello_world));
 		for (int thread_id = 0; thread_id < 5; ++thread_id) {
-			manager.start<const std::string &>(hello_world, [](auto code) {
+			manager.start<BFProgram_p>(program, [](auto program) {
 				BFImplementation::env_p env(new BFEnvironment());
-				env->assignCode(code);
+				env->assignProgram(program);
 				BFMicrothreadManager::impl_p impl(new BFImplementation(env));
 				return impl;
 			});
@@ -312,6 +1001,312 @@ void BFTest() {
 	std::cout << "Run completed in " << duration << "ms" << std::endl;
 }
 
+// A program to run as part of a batch, with the input to give it
+struct BFJob {
+	std::string name;
+	std::string source;
+	std::string input;
+	BFDispatchMode dispatch = BFDISPATCH;
+};
+
+// What a job printed, or why it could not be run
+struct BFJobResult {
+	std::string name;
+	std::string output;
+	std::string error;
+	// compiled instructions it executed
+	uint64_t instructions = 0;
+};
+
+// Jobs each batch worker keeps running at once, interleaved by its manager
+const unsigned BFBATCHWIDTH = 16;
+
+// Run independent jobs across a pool of OS threads. Each worker has a
+// manager of its own and claims jobs from the list as it has room for them.
+// Results are in submission order. A workers of 0 uses one per hardware
+// thread.
+std::vector<BFJobResult> BFRunBatch(const std::vector<BFJob> &jobs, unsigned workers = 0) {
+	if (workers == 0)
+		workers = std::max(1u, std::thread::hardware_concurrency());
+	workers = (unsigned)std::min<size_t>(workers, std::max<size_t>(1, jobs.size()));
+
+	std::vector<BFJobResult> results(jobs.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::exception_ptr> failures(workers);
+
+	auto work = [&jobs, &results, &next](std::exception_ptr &failure) {
+		try {
+			BFMicrothreadManager manager;
+			size_t running = 0;
+			for (;;) {
+				while (running < BFBATCHWIDTH) {
+					const size_t index = next++;
+					if (index >= jobs.size())
+						break;
+					const BFJob &job = jobs[index];
+					results[index].name = job.name;
+					BFEnvironment::env_p env(new BFEnvironment());
+					try {
+						env->assignCode(job.source);
+					} catch (const std::runtime_error &e) {
+						results[index].error = e.what();
+						continue;
+					}
+					std::shared_ptr<BFMemoryOutput> output(new BFMemoryOutput());
+					env->output = output;
+					env->dispatch_mode = job.dispatch;
+					env->input.reset(new BFMemoryInput(job.input));
+					const ThreadId thread_id = manager.start<BFEnvironment::env_p>(env, [](auto env) {
+						return BFMicrothreadManager::impl_p(new BFImplementation(env));
+					});
+					// A job that fails does so alone, with its failure as the error
+					manager.onComplete(thread_id, [&results, &running, index, env, output](const BFMicrothreadManager::_completion_type &completion) {
+						BFJobResult &result = results[index];
+						result.instructions = env->executed;
+						if (completion.failure) {
+							try {
+								std::rethrow_exception(completion.failure);
+							} catch (const std::exception &e) {
+								result.error = e.what();
+							} catch (...) {
+								result.error = "unknown failure";
+							}
+						} else {
+							result.output = output->str();
+						}
+						--running;
+					});
+					++running;
+				}
+				if (running == 0)
+					break;
+				manager.executeThreads();
+			}
+		} catch (...) {
+			failure = std::current_exception();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned n = 1; n < workers; ++n)
+		pool.emplace_back(work, std::ref(failures[n]));
+	work(failures[0]);
+	for (auto &worker : pool)
+		worker.join();
+	for (auto &failure : failures)
+		if (failure)
+			std::rethrow_exception(failure);
+	return results;
+}
+
+// Whole contents of a file. Returns: false if it could not be read.
+bool BFReadFile(const std::string &path, std::string &contents) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::ostringstream buffer;
+	buffer << file.rdbuf();
+	contents = buffer.str();
+	return true;
+}
+
+// Brainfuck sources in a directory (.b or .bf), sorted by name. Returns:
+// false if path is not a directory.
+bool BFListPrograms(const std::string &path, std::vector<std::string> &programs) {
+	std::vector<std::string> names;
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA((path + "\\*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+	do {
+		names.push_back(entry.cFileName);
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+#else
+	DIR *dir = opendir(path.c_str());
+	if (dir == nullptr)
+		return false;
+	while (const dirent *entry = readdir(dir))
+		names.push_back(entry->d_name);
+	closedir(dir);
+#endif
+	std::sort(names.begin(), names.end());
+	for (const auto &name : names) {
+		const size_t dot = name.rfind('.');
+		if (dot == std::string::npos)
+			continue;
+		const std::string extension = name.substr(dot);
+		if (extension == ".b" || extension == ".bf")
+			programs.push_back(path + "/" + name);
+	}
+	return true;
+}
+
+// The input for a program: the file beside it ending .in, if there is one
+std::string BFProgramInput(const std::string &program) {
+	std::string input;
+	BFReadFile(program.substr(0, program.rfind('.')) + ".in", input);
+	return input;
+}
+
+// stackless bf-batch [-j workers] <directory or program>...
+// Runs every program given, or found in a directory given, in parallel and
+// prints their outputs in the order given.
+int bf_batch_main(int argc, char *argv[]) {
+	unsigned workers = 0;
+	std::vector<std::string> programs;
+	for (int n = 0; n < argc; ++n) {
+		const std::string arg = argv[n];
+		if (arg == "-j" && n + 1 < argc)
+			workers = (unsigned)std::stoul(argv[++n]);
+		else if (!BFListPrograms(arg, programs))
+			programs.push_back(arg);
+	}
+	if (programs.empty()) {
+		std::cerr << "usage: stackless bf-batch [-j workers] <directory or program>..." << std::endl;
+		return 1;
+	}
+
+	std::vector<BFJob> jobs;
+	for (const auto &program : programs) {
+		BFJob job{ program, "", BFProgramInput(program) };
+		if (!BFReadFile(program, job.source)) {
+			std::cerr << program << ": cannot read" << std::endl;
+			return 1;
+		}
+		jobs.push_back(job);
+	}
+
+	std::vector<BFJobResult> results;
+	auto duration = StacklessTimekeeper::measure([&results, &jobs, workers]() {
+		results = BFRunBatch(jobs, workers);
+	});
+
+	int status = 0;
+	for (const auto &result : results) {
+		if (!result.error.empty()) {
+			std::cerr << result.name << ": " << result.error << std::endl;
+			status = 1;
+			continue;
+		}
+		std::cout << result.output;
+	}
+	std::cout.flush();
+	std::cerr << results.size() << " programs completed in " << duration << "ms" << std::endl;
+	return status;
+}
+
+// stackless bf-check <directory>...
+// Runs each program in the directories given, one at a time, and compares
+// what it prints with the file beside it ending .out. Reports how long each
+// took and how many compiled instructions a second it ran.
+int bf_check_main(int argc, char *argv[]) {
+	std::vector<std::string> programs;
+	for (int n = 0; n < argc; ++n) {
+		if (!BFListPrograms(argv[n], programs)) {
+			std::cerr << argv[n] << ": not a directory" << std::endl;
+			return 1;
+		}
+	}
+	if (programs.empty()) {
+		std::cerr << "usage: stackless bf-check <directory>..." << std::endl;
+		return 1;
+	}
+
+	unsigned failures = 0;
+	uint64_t total_instructions = 0;
+	unsigned long long total_duration = 0;
+	for (const auto &program : programs) {
+		BFJob job{ program, "", BFProgramInput(program) };
+		std::string expected;
+		const bool readable = BFReadFile(program, job.source);
+		const bool checkable = BFReadFile(program.substr(0, program.rfind('.')) + ".out", expected);
+		if (!readable || !checkable) {
+			std::cerr << "FAIL " << program << ": " << (readable ? "no .out file" : "cannot read") << std::endl;
+			++failures;
+			continue;
+		}
+
+		std::vector<BFJobResult> results;
+		auto duration = StacklessTimekeeper::measure([&results, &job]() {
+			results = BFRunBatch(std::vector<BFJob>{ job }, 1);
+		});
+		const BFJobResult &result = results.front();
+		const bool passed = result.error.empty() && result.output == expected;
+		if (!passed)
+			++failures;
+		total_instructions += result.instructions;
+		total_duration += duration;
+
+		std::cerr << (passed ? "ok   " : "FAIL ") << program << ": ";
+		if (!result.error.empty())
+			std::cerr << result.error;
+		else
+			std::cerr << result.instructions << " instructions in " << duration << "ms, "
+			          << result.instructions / 1000 / std::max(1ULL, duration) << "M/s";
+		std::cerr << std::endl;
+	}
+	std::cerr << "total programs " << programs.size() << ", total failures " << failures << std::endl;
+	std::cerr << "Ran " << total_instructions << " instructions in " << total_duration << "ms, "
+	          << total_instructions / 1000 / std::max(1ULL, total_duration) << "M/s" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
+
+// stackless bf-bench <directory or program>...
+// Times each program under every dispatch mode, checking that they all
+// print the same.
+int bf_bench_main(int argc, char *argv[]) {
+	std::vector<std::string> programs;
+	for (int n = 0; n < argc; ++n)
+		if (!BFListPrograms(argv[n], programs))
+			programs.push_back(argv[n]);
+	if (programs.empty()) {
+		std::cerr << "usage: stackless bf-bench <directory or program>..." << std::endl;
+		return 1;
+	}
+
+	const std::vector<std::pair<BFDispatchMode, const char *>> modes = {
+		{ DispatchBySwitch, "switch" },
+		{ DispatchByTable, "table" },
+#ifdef STACKLESS_COMPUTED_GOTO
+		{ DispatchThreaded, "threaded" },
+#endif
+	};
+	int status = 0;
+	for (const auto &program : programs) {
+		BFJob job{ program, "", BFProgramInput(program) };
+		if (!BFReadFile(program, job.source)) {
+			std::cerr << program << ": cannot read" << std::endl;
+			return 1;
+		}
+		std::cerr << program << ":";
+		std::string first;
+		for (const auto &mode : modes) {
+			job.dispatch = mode.first;
+			std::vector<BFJobResult> results;
+			auto duration = StacklessTimekeeper::measure([&results, &job]() {
+				results = BFRunBatch(std::vector<BFJob>{ job }, 1);
+			});
+			const BFJobResult &result = results.front();
+			if (!result.error.empty()) {
+				std::cerr << " " << result.error;
+				status = 1;
+				break;
+			}
+			if (&mode == &modes.front())
+				first = result.output;
+			else if (result.output != first) {
+				std::cerr << " " << mode.second << " output differs";
+				status = 1;
+			}
+			std::cerr << " " << mode.second << " " << duration << "ms";
+		}
+		std::cerr << std::endl;
+	}
+	return status;
+}
+
 struct BFInterpreterState {
 	BFInterpreterState() {
 
@@ -0,0 +1,213 @@
+#include "stdafx.h"
+
+#include "Stackless.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <stdio.h>
+#include <unistd.h>
+#endif
+
+using namespace stackless;
+using namespace stackless::microthreading;
+using namespace stackless::timekeeping;
+
+namespace implementations {
+namespace scale {
+
+// Threads that do nothing but sleep, wait for a message, and finish, for
+// measuring what a thread costs the manager when there are a great many.
+
+enum ScaleState {
+	ScaleStart,
+	// Asleep until the timer runs out
+	ScaleSleeping,
+	// Parked until the message arrives
+	ScaleWaiting,
+	ScaleDone,
+};
+
+struct ScaleImplementation;
+typedef MicrothreadManager<ScaleImplementation> ScaleManager;
+
+// Shared by every thread
+struct ScaleEnvironment : public Environment<std::vector<int>> {
+	typedef std::shared_ptr<ScaleEnvironment> env_p;
+	typedef env_p _env_p;
+
+	ScaleEnvironment(ScaleManager &manager, const ThreadTimeUnit sleep) : manager(manager), sleep(sleep) {
+	}
+
+	ScaleManager &manager;
+	const ThreadTimeUnit sleep;
+};
+
+struct ScaleFrame final : public Frame<int, ScaleState, ScaleEnvironment> {
+	ScaleFrame(env_p environment) : Frame<int, ScaleState, ScaleEnvironment>(environment), state(ScaleStart) {
+		result = 0;
+	}
+	bool isResolved() const {
+		return state == ScaleDone;
+	}
+	bool isArgumentsResolved() const {
+		return true;
+	}
+
+	ScaleState state;
+};
+
+struct ScaleImplementation final : public StaticImplementation<ScaleImplementation, ScaleEnvironment, ScaleFrame> {
+	ScaleImplementation(env_p _env) : StaticImplementation<ScaleImplementation, ScaleEnvironment, ScaleFrame>(_env), frame(_env) {
+	}
+	ScaleFrame &currentFrame() {
+		return frame;
+	}
+	bool runFrame(ScaleFrame &frame) {
+		ScaleManager &manager = frame.env->manager;
+		const ThreadId self = manager.getCurrentThread()->first;
+		switch (frame.state) {
+		case ScaleStart:
+			frame.state = ScaleSleeping;
+			manager.thread_sleep_for(self, frame.env->sleep);
+			break;
+		case ScaleSleeping:
+			frame.state = ScaleWaiting;
+			manager.thread_wait_message(self);
+			break;
+		case ScaleWaiting:
+			frame.state = ScaleDone;
+			break;
+		case ScaleDone:
+			break;
+		}
+		return true;
+	}
+	// Taken straight into the frame, so the mailbox is never allocated
+	bool deliver_message(const int &message) {
+		frame.result = message;
+		return true;
+	}
+private:
+	ScaleFrame frame;
+};
+
+// The size thread-bench measures, and that the manager's million threads
+// rely on
+static_assert(sizeof(ScaleManager::_thread_type) <= 64, "a thread is kept to 64 bytes");
+
+// Resident memory of the process in bytes, or 0 where it cannot be read
+std::size_t ScaleResident() {
+#ifdef __linux__
+	FILE *statm = fopen("/proc/self/statm", "r");
+	if (statm == nullptr)
+		return 0;
+	unsigned long size = 0, resident = 0;
+	const int read = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	return read == 2 ? resident * (std::size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
+
+typedef Timekeeper<std::chrono::microseconds, std::chrono::steady_clock> ScaleTimekeeper;
+
+// stackless thread-bench [count]: start count threads (a million by
+// default), put them all to sleep, wake them, park them waiting for a
+// message, and send each one, joining them all as a group. Reports memory
+// per thread and the time each tick of the manager takes along the way,
+// then the spread of time slices and of how late the sleepers were woken.
+int thread_bench_main(int argc, char *argv[]) {
+	const unsigned long count = argc > 0 ? strtoul(argv[0], nullptr, 10) : 1000000;
+	if (count == 0) {
+		std::cerr << "usage: stackless thread-bench [count]" << std::endl;
+		return 1;
+	}
+	// Long enough that no thread wakes during the idle ticks
+	const ThreadTimeUnit sleep(100 + count / 500);
+	std::cerr << "thread record " << sizeof(ScaleManager::_thread_type) << " bytes, ";
+	std::cerr << "implementation " << sizeof(ScaleImplementation) << " bytes" << std::endl;
+
+	int status = 0;
+	{
+		ScaleManager manager;
+		PhaseTimers timers;
+		manager.setTimers(&timers);
+		ScaleManager::env_p env(std::make_shared<ScaleEnvironment>(manager, sleep));
+		const std::size_t resident = ScaleResident();
+		auto report = [count](const char *what, const unsigned long long us) {
+			std::cerr << what << " " << us / 1000 << "ms, " << (double)us * 1000 / count << "ns/thread" << std::endl;
+		};
+
+		report("start", ScaleTimekeeper::measure([&manager, &env, count]() {
+			for (unsigned long n = 0; n < count; ++n)
+				manager.start([&env]() {
+					return memory::make_pooled<ScaleImplementation>(env);
+				});
+		}));
+		const std::size_t started = ScaleResident();
+		if (started > resident)
+			std::cerr << "resident " << (started - resident) / count << " bytes/thread" << std::endl;
+
+		report("sleep tick", ScaleTimekeeper::measure([&manager]() {
+			manager.executeThreads();
+		}));
+		const ThreadTimePoint due = ThreadClock::now() + sleep;
+		// Nothing is due yet, so this is the cost of looking over them all
+		const int idle_ticks = 5;
+		unsigned long long idle = 0;
+		int woken = 0;
+		for (int n = 0; n < idle_ticks; ++n)
+			idle += ScaleTimekeeper::measure([&manager, &woken]() {
+				woken += manager.executeThreads();
+			});
+		report("idle tick", idle / idle_ticks);
+		if (woken != 0)
+			std::cerr << woken << " threads woke early" << std::endl;
+
+		std::this_thread::sleep_until(due);
+		report("wake tick", ScaleTimekeeper::measure([&manager]() {
+			manager.executeThreads();
+		}));
+		if (manager.parkedCount() != count) {
+			std::cerr << "expected " << count << " parked, got " << manager.parkedCount() << std::endl;
+			status = 1;
+		}
+		report("parked tick", ScaleTimekeeper::measure([&manager]() {
+			manager.executeThreads();
+		}));
+
+		ScaleManager::group_p group(std::make_shared<ScaleManager::_group_type>());
+		report("group", ScaleTimekeeper::measure([&manager, &group, count]() {
+			for (unsigned long n = 0; n < count; ++n)
+				manager.addToGroup(group, (ThreadId)n);
+		}));
+		report("send", ScaleTimekeeper::measure([&manager, count]() {
+			for (unsigned long n = 0; n < count; ++n)
+				manager.send((int)n, (ThreadId)n);
+		}));
+		report("join all", ScaleTimekeeper::measure([&manager, &group]() {
+			manager.runGroupToCompletion(group);
+		}));
+		if (group->completions().size() != count) {
+			std::cerr << "expected " << count << " completions, got " << group->completions().size() << std::endl;
+			status = 1;
+		}
+		if (manager.hasThreads()) {
+			std::cerr << "expected no threads, got " << manager.threadCount() << std::endl;
+			status = 1;
+		}
+		timers.write(std::cerr);
+	}
+	return status;
+}
+
+}
+}
@@ -2,14 +2,44 @@
 
 #include "Stackless.hpp"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <forward_list>
+#include <fstream>
 #include <iostream>
 #include <list>
 #include <map>
+#include <mutex>
+#include <queue>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCHEME_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+#ifdef __linux__
+#include <climits>
+#include <poll.h>
+#include <sys/socket.h>
+#endif
+
 using namespace stackless;
 using namespace stackless::microthreading;
 using namespace stackless::timekeeping;
@@ -25,37 +55,169 @@ namespace scheme {
 
 // return given mumber as a string
 std::string str(long n) { std::ostringstream os; os << n; return os.str(); }
+std::string str(long long n) { std::ostringstream os; os << n; return os.str(); }
 
 // return true iff given character is '0'..'9'
 bool isdig(char c) { return isdigit(static_cast<unsigned char>(c)) != 0; }
 
 ////////////////////// cell
 
-enum cell_type { Symbol, Number, List, Proc, Lambda };
+enum cell_type { Symbol, Number, List, Proc, Lambda, Vector, Hash, Future };
+
+// Text a thread keeps, such as the name or value of a cell, charged to the
+// thread's arena when it has one
+typedef std::basic_string<char, std::char_traits<char>, memory::ThreadAllocator<char>> text;
+std::string str(const text &t) { return std::string(t.data(), t.size()); }
 
 struct environment; // forward declaration; cell and environment reference each other
 typedef std::shared_ptr<environment> env_p;
+struct cell;
+// Lists of cells, charged to the thread's arena like text
+typedef std::vector<cell, memory::ThreadAllocator<cell>> cells;
+struct numeric_vector; // see numeric vectors below
+typedef std::shared_ptr<numeric_vector> vector_p;
+struct hash_table; // see hash tables below
+typedef std::shared_ptr<hash_table> hash_p;
+struct future_state; // see futures below
+typedef std::shared_ptr<future_state> future_p;
+
+// Inline cache for the global binding of a symbol at one call site. Copies of
+// a parsed symbol share the same cache, and may be evaluated by several OS
+// threads at once (see futures), so the cache is a small seqlock. A reader
+// that races with a fill simply misses.
+struct global_cache {
+	// return the cached binding if it was found in the given version
+	const cell *get(unsigned long current) const {
+		const unsigned seq = sequence.load(std::memory_order_acquire);
+		if (seq & 1)
+			return nullptr;
+		const unsigned long found_in = version.load(std::memory_order_relaxed);
+		const cell *result = binding.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (found_in != current || sequence.load(std::memory_order_relaxed) != seq)
+			return nullptr;
+		return result;
+	}
+
+	void set(unsigned long current, const cell *found) {
+		unsigned seq = sequence.load(std::memory_order_relaxed);
+		// Leave it to whoever is already filling the cache
+		if ((seq & 1) || !sequence.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed))
+			return;
+		std::atomic_thread_fence(std::memory_order_release);
+		version.store(current, std::memory_order_relaxed);
+		binding.store(found, std::memory_order_relaxed);
+		sequence.store(seq + 2, std::memory_order_release);
+	}
+
+private:
+	std::atomic<unsigned> sequence{ 0 }; // odd while being filled
+	std::atomic<unsigned long> version{ 0 }; // version of the global environment binding was found in
+	std::atomic<const cell *> binding{ nullptr };
+};
+typedef std::shared_ptr<global_cache> global_cache_p;
+
+// The items of a list. Copies share the items, so lists are bound, passed and
+// sent as messages without being copied; a change made through one copy first
+// gives that copy items of its own. Items are only ever read in place, so
+// nothing is written where another copy, perhaps on another OS thread, can see.
+template<typename T>
+struct shared_list {
+	typedef std::vector<T, memory::ThreadAllocator<T>> items_type;
+	typedef typename items_type::const_iterator const_iterator;
+	typedef const_iterator iterator;
+
+	shared_list() {}
+	shared_list(const items_type &items) : items(items.empty() ? nullptr : make_items(items)) {}
+	shared_list &operator=(const items_type &other) {
+		items = other.empty() ? nullptr : make_items(other);
+		return *this;
+	}
+
+	operator const items_type &() const { return get(); }
+	size_t size() const { return items ? items->size() : 0; }
+	bool empty() const { return size() == 0; }
+	const T &operator[](size_t i) const { return (*items)[i]; }
+	const T &front() const { return items->front(); }
+	const T &back() const { return items->back(); }
+	const_iterator begin() const { return get().begin(); }
+	const_iterator end() const { return get().end(); }
+	const_iterator cbegin() const { return get().begin(); }
+	const_iterator cend() const { return get().end(); }
+
+	void push_back(const T &item) { own().push_back(item); }
+	void push_back(T &&item) { own().push_back(std::move(item)); }
+	void reserve(size_t n) { own().reserve(n); }
+	void clear() { items.reset(); }
+	// whether both lists still share the same items
+	bool shares(const shared_list &other) const { return items == other.items; }
+	const_iterator erase(const_iterator first, const_iterator last) {
+		const size_t from = first - begin(), to = last - begin();
+		items_type &own_items = own();
+		return own_items.erase(own_items.begin() + from, own_items.begin() + to);
+	}
+	const_iterator erase(const_iterator at) { return erase(at, at + 1); }
+
+private:
+	const items_type &get() const {
+		static const items_type none;
+		return items ? *items : none;
+	}
+	// the items, copied first if any other list can see them
+	items_type &own() {
+		if (!items)
+			items = make_items();
+		else if (items.use_count() > 1)
+			items = make_items(*items);
+		else // the last other owner may have been reading them on another OS thread
+			std::atomic_thread_fence(std::memory_order_acquire);
+		return *items;
+	}
+
+	// in the thread's arena, like the items themselves
+	template<typename... Args>
+	static std::shared_ptr<items_type> make_items(Args&&... args) {
+		return std::allocate_shared<items_type>(memory::ThreadAllocator<items_type>(), std::forward<Args>(args)...);
+	}
+
+	std::shared_ptr<items_type> items;
+};
 
 					// a variant that can hold any kind of lisp value
 struct cell {
-	typedef cell(*proc_type)(const std::vector<cell> &);
-	typedef std::vector<cell>::const_iterator iter;
-	typedef std::map<std::string, cell> map;
-	cell_type type; std::string val; std::vector<cell> list; proc_type proc; env_p env;
+	typedef cell(*proc_type)(const cells &);
+	typedef cells::const_iterator iter;
+	typedef std::map<text, cell, std::less<text>, memory::ThreadAllocator<std::pair<const text, cell>>> map;
+	cell_type type; text val; shared_list<cell> list; proc_type proc; env_p env; global_cache_p cache; vector_p vec; hash_p hash; future_p fut;
 	cell(cell_type type = Symbol) : type(type), env(nullptr) {}
-	cell(cell_type type, const std::string & val) : type(type), val(val), env(nullptr) {}
-	cell(const std::vector<cell> &cells) : type(List), list(cells) {}
+	cell(cell_type type, const text & val) : type(type), val(val), env(nullptr) {}
+	cell(cell_type type, const std::string & val) : type(type), val(val.data(), val.size()), env(nullptr) {}
+	cell(cell_type type, const char * val) : type(type), val(val), env(nullptr) {}
+	cell(const cells &items) : type(List), list(items) {}
 	cell(proc_type proc) : type(Proc), proc(proc), env(nullptr) {}
-	cell(const cell &copy) : type(copy.type), val(copy.val), list(copy.list), proc(copy.proc), env(copy.env) {}
+	cell(vector_p vec) : type(Vector), env(nullptr), vec(vec) {}
+	cell(hash_p hash) : type(Hash), env(nullptr), hash(hash) {}
+	cell(future_p fut) : type(Future), env(nullptr), fut(fut) {}
+	cell(const cell &copy) : type(copy.type), val(copy.val), list(copy.list), proc(copy.proc), env(copy.env), cache(copy.cache), vec(copy.vec), hash(copy.hash), fut(copy.fut) {}
+	cell(cell &&move) noexcept : type(move.type), val(std::move(move.val)), list(std::move(move.list)), proc(move.proc),
+		env(std::move(move.env)), cache(std::move(move.cache)), vec(std::move(move.vec)), hash(std::move(move.hash)), fut(std::move(move.fut)) {}
+	cell &operator=(const cell &) = default;
+	cell &operator=(cell &&) = default;
 };
 
-typedef std::vector<cell> cells;
 typedef cells::const_iterator cellit;
 
 const cell false_sym(Symbol, "#f");
 const cell true_sym(Symbol, "#t"); // anything that isn't false_sym is true
 const cell nil(Symbol, "nil");
 
+// a symbol that caches its global binding wherever it is evaluated
+cell symbol(const std::string & name) {
+	cell result(Symbol, name);
+	result.cache = std::make_shared<global_cache>();
+	return result;
+}
+
 std::string to_string(const cell & exp);
 
 namespace instruction {
@@ -67,7 +229,8 @@ namespace instruction {
 		Lambda,
 		Begin,
 		Proc,
-		Invalid
+		Invalid,
+		Count     // the number of instructions
 	};
 }
 
@@ -89,6 +252,12 @@ struct SchemeInstructionConverter
 			return instruction::Proc;
 		case List:
 			return instruction::Proc;
+			// Data, which cannot be called
+		case Number:
+		case Vector:
+		case Hash:
+		case Future:
+			return instruction::Invalid;
 		}
 		return instruction::Invalid;
 	}
@@ -96,14 +265,58 @@ struct SchemeInstructionConverter
 
 ////////////////////// environment
 
+struct heap_image; // forward declaration; see heap images below
+
+// An immutable copy of the bindings of a global environment. Futures read
+// globals from the copy taken when they were started, so OS threads never
+// read a map that define is changing. The stamp is unique, like environment
+// versions, so inline caches filled from a snapshot only match readers of
+// that snapshot.
+struct global_snapshot {
+	global_snapshot(const environment *source, const cell::map &bindings, unsigned long stamp)
+		: source(source), bindings(bindings), stamp(stamp) {}
+
+	const environment *const source;
+	const cell::map bindings;
+	const unsigned long stamp;
+};
+typedef std::shared_ptr<const global_snapshot> snapshot_p;
+
+// The snapshot read by the future running on this OS thread, if any, the
+// future's reference to it, and the version inline caches are filled under
+// meanwhile
+thread_local const global_snapshot *active_snapshot = nullptr;
+thread_local const snapshot_p *active_owner = nullptr;
+thread_local unsigned long active_version = 0;
+
+// Makes a snapshot active for the lifetime of the scope
+struct snapshot_scope {
+	snapshot_scope(const snapshot_p &snapshot)
+		: outer(active_snapshot), outer_owner(active_owner), outer_version(active_version) {
+		active_snapshot = snapshot.get();
+		active_owner = &snapshot;
+		active_version = snapshot->stamp;
+	}
+	~snapshot_scope() {
+		active_snapshot = outer;
+		active_owner = outer_owner;
+		active_version = outer_version;
+	}
+private:
+	const global_snapshot *const outer;
+	const snapshot_p *const outer_owner;
+	const unsigned long outer_version;
+};
+
 // a dictionary that (a) associates symbols with cells, and
 // (b) can chain to an "outer" dictionary
 struct environment : public Environment<cells> {
 	typedef env_p _env_p;
-	environment(env_p outer = nullptr) : outer_(outer) {}
+	environment(env_p outer = nullptr)
+		: outer_(outer), global_(outer ? outer->global_ : this), version_(++version_counter) {}
 
 	environment(const cells & parms, const cells & args, env_p outer)
-		: outer_(outer)
+		: outer_(outer), global_(outer ? outer->global_ : this), version_(++version_counter)
 	{
 		cellit a = args.begin();
 		for (cellit p = parms.begin(); p != parms.end(); ++p)
@@ -111,36 +324,151 @@ struct environment : public Environment<cells> {
 	}
 
 	// map a variable name onto a cell
-	typedef std::map<std::string, cell> map;
+	typedef cell::map map;
 
-	// return a reference to the innermost environment where 'var' appears
-	map & find(const std::string & var)
+	// return the cell bound to 'var' in the innermost environment where it appears
+	const cell & find(const text & var)
 	{
-		if (env_.find(var) != env_.end())
-			return env_; // the symbol exists in this environment
-		if (outer_)
-			return outer_->find(var); // attempt to find the symbol in some "outer" env
-		std::cout << "unbound symbol '" << var << "'\n";
-		exit(1);
+		environment *holder;
+		return resolve(var, holder);
+	}
+
+	// change the innermost binding of 'var'
+	void set(const text & var, const cell &val)
+	{
+		environment *holder;
+		resolve(var, holder);
+		if (holder->reads_snapshot())
+			throw std::runtime_error("cannot set a global from a future");
+		holder->env_[var] = val;
+		if (holder == global_)
+			snapshot_.reset();
 	}
 
 	// return a reference to the cell associated with the given symbol 'var'
-	cell & operator[] (const std::string & var)
+	cell & operator[] (const text & var)
 	{
 		return env_[var];
 	}
 
-	void define(const std::string & var, const cell &val) {
+	// return the cell bound to 'symbol', using and filling its inline cache
+	// when the binding lives in the global environment
+	const cell & lookup(const cell & symbol)
+	{
+		global_cache *cache = symbol.cache.get();
+		const unsigned long version = global_->reads_snapshot() ? active_version
+			: global_->version_.load(std::memory_order_acquire);
+		if (cache) {
+			if (const cell *cached = cache->get(version))
+				return *cached;
+		}
+		environment *holder;
+		const cell &binding = resolve(symbol.val, holder);
+		if (cache && holder == global_)
+			cache->set(version, &binding);
+		return binding;
+	}
+
+	// define a variable; this may shadow a global, so inline caches are invalidated
+	void define(const text & var, const cell &val) {
+		if (reads_snapshot())
+			throw std::runtime_error("cannot define a global from a future");
+		env_[var] = val;
+		global_->version_.store(++version_counter, std::memory_order_release);
+		if (active_snapshot)
+			active_version = ++version_counter;
+		if (this == global_)
+			snapshot_.reset();
+	}
+
+	// The bindings of this global environment as they are now, for futures.
+	// A snapshot is shared until the bindings next change. Only the thread
+	// defining globals may take one.
+	snapshot_p snapshot() {
+		if (!snapshot_)
+			snapshot_ = std::make_shared<global_snapshot>(this, bindings(), ++version_counter);
+		return snapshot_;
+	}
+
+	// bind a lambda parameter. Parameter names are fixed by the lambda, so
+	// this does not change how any call site resolves and caches stay valid.
+	void bind(const text & var, const cell &val) {
 		env_[var] = val;
 	}
 
+	env_p outer() const { return outer_; }
+	environment *global() const { return global_; }
+
+	// all bindings in this environment, decoding any still held in an image
+	const map & bindings() {
+		if (image_)
+			materialize_all();
+		return env_;
+	}
+
+	// Decode everything still held in heap images that this environment
+	// chain was loaded from. Lookups then only read the maps, so OS threads
+	// can share the environments.
+	void prepare_for_sharing();
+
 private:
+	friend struct heap_image;
+	friend env_p load_image(const std::string &path, env_p external);
+	bool materialize(const text & var);
+	void materialize_all();
+
+	// whether this is a global read through the active snapshot
+	bool reads_snapshot() const {
+		return active_snapshot && active_snapshot->source == this;
+	}
+	// the cell bound to 'var' and the environment it was found in
+	const cell & resolve(const text & var, environment *&holder)
+	{
+		if (reads_snapshot()) {
+			auto it = active_snapshot->bindings.find(var);
+			if (it != active_snapshot->bindings.end()) {
+				holder = this;
+				return it->second;
+			}
+		} else {
+			auto it = env_.find(var);
+			if (it != env_.end() || (image_ && materialize(var) && (it = env_.find(var)) != env_.end())) {
+				holder = this; // the symbol exists in this environment, or was still waiting in a heap image
+				return it->second;
+			}
+		}
+		if (outer_)
+			return outer_->resolve(var, holder); // attempt to find the symbol in some "outer" env
+		std::cout << "unbound symbol '" << var << "'\n";
+		exit(1);
+	}
+
 	map env_; // inner symbol->cell mapping
 	env_p outer_; // next adjacent outer env, or 0 if there are no further environments
+	environment *global_; // outermost env
+	// Version stamp of the bindings visible through this (global) environment.
+	// Stamps are unique across all environments, so a cache entry can only
+	// match the environment and state it was filled from.
+	std::atomic<unsigned long> version_;
+	static std::atomic<unsigned long> version_counter;
+	// image this environment was loaded from, and its binding table in that image
+	std::shared_ptr<heap_image> image_;
+	uint32_t image_index_ = 0;
+	// environments and hash tables that bindings still in the image reach,
+	// held as the decoded bindings will hold them
+	std::vector<env_p> image_refs_;
+	std::vector<hash_p> image_tables_;
+	// copy of the bindings for futures, while still current
+	snapshot_p snapshot_;
 };
+std::atomic<unsigned long> environment::version_counter(0);
+
+// Set by a builtin that cannot complete yet, such as receive with an empty
+// mailbox. The builtin is called again when its thread next runs.
+thread_local bool builtin_blocked = false;
 
 // frame implementation
-struct SchemeFrame : public Frame<cell, std::string, environment> {
+struct SchemeFrame final : public Frame<cell, std::string, environment> {
 private:
 	SchemeFrame(env_p environment)
 		: Frame(environment),
@@ -164,9 +492,72 @@ public:
 		exp = expression;
 		expressions.push_back(exp);
 		exp_it = expressions.cbegin();
-		setExpression(exp);
+		// Arguments are resolved when the frame first executes, so that any
+		// builtins run on the thread that owns the frame.
+		loadExpression(exp);
+	}
+	SchemeFrame(const SchemeFrame &) = delete;
+	~SchemeFrame() {
+		// Unlink the chain as it goes, so that a deep one does not recurse
+		SchemeFrame *next = subframe;
+		while (next != nullptr) {
+			SchemeFrame *after = next->subframe;
+			next->subframe = nullptr;
+			delete next;
+			next = after;
+		}
+	}
+
+	// The frame's own state as a list, for checkpoints. The environment is
+	// kept as an empty lambda closing over it, so that heap images save it
+	// like any other. The subframe is not included.
+	cell saveState() const {
+		cell state(List), closure(Lambda);
+		closure.env = env;
+		state.list.reserve(10);
+		state.list.push_back(closure);
+		state.list.push_back(exp);
+		state.list.push_back(list_of(expressions));
+		state.list.push_back(cell(Number, str((long)(exp_it - expressions.cbegin()))));
+		state.list.push_back(list_of(arguments));
+		state.list.push_back(cell(Number, str((long)(arg_it - arguments.cbegin()))));
+		state.list.push_back(list_of(resolved_arguments));
+		state.list.push_back(resolved ? true_sym : false_sym);
+		state.list.push_back(cell(Number, str((long)subframe_mode)));
+		state.list.push_back(result);
+		return state;
+	}
+	// Take on a state from saveState, leaving the subframe as it is
+	void loadState(const cell &state) {
+		if (state.type != List || state.list.size() != 10 || state.list[0].type != Lambda)
+			throw std::runtime_error("corrupt checkpoint");
+		const unsigned long exp_index = atol(state.list[3].val.c_str());
+		const unsigned long arg_index = atol(state.list[5].val.c_str());
+		const long mode = atol(state.list[8].val.c_str());
+		if (exp_index > state.list[2].list.size() || arg_index > state.list[4].list.size() || mode < None || mode > Procedure)
+			throw std::runtime_error("corrupt checkpoint");
+		env = state.list[0].env;
+		exp = state.list[1];
+		expressions = state.list[2].list;
+		exp_it = expressions.cbegin() + exp_index;
+		arguments = state.list[4].list;
+		arg_it = arguments.cbegin() + arg_index;
+		resolved_arguments = state.list[6].list;
+		resolved = state.list[7].val == true_sym.val;
+		subframe_mode = (SubframeMode)mode;
+		result = state.list[9];
+	}
+	// Create a frame from saveState, without its subframe
+	static SchemeFrame *restoreState(const cell &state) {
+		std::unique_ptr<SchemeFrame> frame(new SchemeFrame(state.list.empty() ? env_p() : state.list[0].env));
+		frame->loadState(state);
+		return frame.release();
 	}
 
+	// Frames come from the running thread's arena, if it has one
+	static void *operator new(std::size_t size) { return stackless::memory::allocate(size); }
+	static void operator delete(void *block) { stackless::memory::deallocate(block); }
+
 	enum SubframeMode {
 		None,
 		Argument,
@@ -248,7 +639,6 @@ public:
 			++exp_it;
 			if (exp_it != expressions.cend()) {
 				setExpression(*exp_it);
-				resolved = false;
 			} else {
 				resolved = true;
 				exp = nil;
@@ -260,6 +650,13 @@ public:
 	}
 
 	void setExpression(const cell &value) {
+		if (loadExpression(value))
+			nextArgument();
+	}
+
+	// Prepare to evaluate an expression. Returns false if it resolved
+	// immediately, or true if it has arguments to resolve.
+	bool loadExpression(const cell &value) {
 		DEBUG("setExpression(" + to_string(value) + ")");
 		resolved = false;
 		arguments.clear();
@@ -269,17 +666,23 @@ public:
 			arg_it = arguments.cbegin();
 			resolved_arguments.clear();
 			resolved = true;
-			return;
+			return false;
 		}
 		arg_it = arguments.cbegin();
-		nextArgument();
+		return true;
+	}
+
+	static cell list_of(const cells &items) {
+		cell c(List);
+		c.list = items;
+		return c;
 	}
 
 	bool resolveArgument(const cell &value) {
 		switch (value.type) {
 		case Symbol:
-			resolved_arguments.push_back(lookup(value.val));
-			DEBUG(std::string("  resolveArgument(") + to_string(value) + std::string(") = ") + to_string(lookup(value.val)));
+			resolved_arguments.push_back(lookup(value));
+			DEBUG(std::string("  resolveArgument(") + to_string(value) + std::string(") = ") + to_string(lookup(value)));
 			return true;
 		case List:
 			if (value.list.empty()) {
@@ -297,8 +700,8 @@ public:
 		}
 	}
 
-	cell &lookup(const std::string &symbol) {
-		return env->find(symbol)[symbol];
+	const cell &lookup(const cell &symbol) {
+		return env->lookup(symbol);
 	}
 
 	bool dispatchCall();
@@ -310,7 +713,7 @@ public:
 	bool resolveExpression(cell &value) {
 		switch (value.type) {
 		case Symbol:
-			result = lookup(value.val);
+			result = lookup(value);
 			return true;
 		case Number:
 			result = value;
@@ -323,7 +726,7 @@ public:
 			}
 			auto first = value.list[0].val;
 			// iterator skips first item
-			cells::iterator it = value.list.begin() + 1;
+			cellit it = value.list.begin() + 1;
 			arguments = cells();
 			exp = value.list[0];
 			if (exp.type == Symbol) {
@@ -420,7 +823,8 @@ template<> struct SchemeDispatcher<instruction::Set> {
 	static bool dispatch(SchemeFrame &frame, cells::const_iterator it) {
 		const cell &var = *it; ++it;
 		const cell &val = *it; ++it;
-		frame.lookup(var.val) = frame.result = val;
+		frame.env->set(var.val, val);
+		frame.result = val;
 		return true;
 	}
 };
@@ -447,7 +851,15 @@ template<> struct SchemeDispatcher<instruction::Proc> {
 		case Proc:
 			// Copy the rest of the resolved arguments to a new list,
 			// that list is passed as the arguments.
-			frame.result = proc.proc(cells(it, frame.resolved_arguments.cend()));
+			{
+				cell result(proc.proc(cells(it, frame.resolved_arguments.cend())));
+				if (builtin_blocked) {
+					// Call again once the thread is woken
+					builtin_blocked = false;
+					return false;
+				}
+				frame.result = std::move(result);
+			}
 			return true;
 		// Lambda: a Scheme procedure
 		// We create a subframe to run the procedure, along with
@@ -471,17 +883,19 @@ template<> struct SchemeDispatcher<instruction::Proc> {
 				// List of arguments
 				args = arglist.list;
 				break;
+			default:
+				throw std::runtime_error("lambda parameters must be a symbol or a list");
 			}
 			// Body
 			const cell body = proc.list[2];
 			// Create environment parented to lambda env
-			env_p new_env(new environment(proc.env));
+			env_p new_env(stackless::memory::make_shared<environment>(proc.env));
 			auto env_arg_it = args.cbegin();
 			// assign remaining arguments to our list of argument
 			// names in new environment.
 			for (; it != frame.resolved_arguments.cend(); ++env_arg_it, ++it) {
 				DEBUG(std::string("    set lambda.") + env_arg_it->val + std::string(" = ") + to_string(*it));
-				new_env->define(env_arg_it->val, *it);
+				new_env->bind(env_arg_it->val, *it);
 			}
 			// Create subframe
 			frame.subframe_mode = SchemeFrame::Procedure;
@@ -495,60 +909,107 @@ template<> struct SchemeDispatcher<instruction::Proc> {
 	}
 };
 
+typedef DispatchTable<instruction::instruction, SchemeDispatcher, instruction::Count, bool, SchemeFrame &, cells::const_iterator> SchemeDispatchTable;
+
 bool SchemeFrame::dispatchCall() {
 	// all of our arguments are now resolved, dispatch
 	cells::const_iterator it = resolved_arguments.cbegin();
 	instruction::instruction ins = SchemeInstructionConverter::convert(exp);
-	switch (ins) {
-	case instruction::If:
-		return SchemeDispatcher<instruction::If>::dispatch(*this, it);
-	case instruction::Begin:
-		return SchemeDispatcher<instruction::Begin>::dispatch(*this, it);
-	case instruction::Set:
-		return SchemeDispatcher<instruction::Set>::dispatch(*this, it);
-	case instruction::Define:
-		return SchemeDispatcher<instruction::Define>::dispatch(*this, it);
-	case instruction::Proc:
-		return SchemeDispatcher<instruction::Proc>::dispatch(*this, it);
-	default:
-		return SchemeDispatcher<instruction::Invalid>::dispatch(*this, it);
-	}
-}
-
-struct SchemeImplementation : public Implementation<environment, SchemeFrame> {
+	return SchemeDispatchTable::dispatch(ins, *this, it);
+}
+
+struct SchemeImplementation final : public StaticImplementation<SchemeImplementation, environment, SchemeFrame> {
 	SchemeImplementation(const cell &ins, env_p _env)
-		: Implementation(_env), frame(SchemeFrame(ins, _env)) {
+		: StaticImplementation(_env), frame(ins, _env) {
+	}
+
+	// Save the thread's frames and mailbox to a checkpoint file. Everything
+	// they refer to is saved too, except for shared: typically the global
+	// environment, which is supplied again on restore.
+	void checkpoint(const std::string &path, const Mailbox<cell> &mailbox, env_p shared) const;
+	// Rebuild a thread from a checkpoint, filling in its mailbox
+	static std::shared_ptr<SchemeImplementation> restore(const std::string &path, Mailbox<cell> &mailbox, env_p shared);
+
+	SchemeFrame &currentFrame() {
+		return frame;
 	}
-	SchemeFrame &getCurrentFrame() {
+	const SchemeFrame &currentFrame() const {
 		return frame;
 	}
-	bool executeFrame(SchemeFrame &fr) {
+	// Each frame in a call is named after the head of the call, which it
+	// keeps in exp; a head that is an expression is shown as lambda
+	void collect_stack(std::vector<std::string> &stack) const {
+		for (const SchemeFrame *f = &frame; f != nullptr; f = f->subframe) {
+			if (f->isResolved())
+				continue;
+			if (f->exp.type == Symbol)
+				stack.push_back(str(f->exp.val));
+			else if (f->exp.type == List)
+				stack.push_back("lambda");
+		}
+	}
+	bool runFrame(SchemeFrame &fr) {
 		fr.execute();
 		return true;
 	}
+	// Whether the thread is parked in receive
+	bool receiving = false;
+	// Text a blocked write is sending, and how much of it has gone
+	std::string output;
+	std::string::size_type written = 0;
+	bool writing = false;
 private:
 	SchemeFrame frame;
 };
 
 struct SchemeThreadManager : public MicrothreadManager<SchemeImplementation>
 {
+protected:
+	// When no thread could run, sleep until the next one is due
+	void yield_process(bool unwatched_resolved, int threads_run) {
+		if (threads_run != 0 || scheduling.empty())
+			return;
+		const ThreadTimePoint next = scheduling.begin()->time_point;
+		if (next != ThreadTimePoint::max())
+			std::this_thread::sleep_until(next);
+	}
 };
-extern SchemeThreadManager SchemeThreadMan;
-SchemeThreadManager SchemeThreadMan;
+// Each OS thread evaluating Scheme has its own thread manager
+extern thread_local SchemeThreadManager SchemeThreadMan;
+thread_local SchemeThreadManager SchemeThreadMan;
+
+// The manager running the innermost evaluation on this OS thread. Builtins
+// working with microthreads use this one.
+thread_local SchemeThreadManager *active_manager = nullptr;
+SchemeThreadManager &current_manager() {
+	return active_manager ? *active_manager : SchemeThreadMan;
+}
 
 cell eval(SchemeThreadManager &tm, const cell &ins, env_p env) {
+	struct active_guard {
+		SchemeThreadManager *outer;
+		active_guard(SchemeThreadManager &tm) : outer(active_manager) { active_manager = &tm; }
+		~active_guard() { active_manager = outer; }
+	} guard(tm);
+	// Timed as the "eval" phase when the manager has timers
+	PhaseTimers *timers = tm.getTimers();
+	ScopedTimer timer(timers ? &timers->phase("eval") : nullptr);
 	// create thread
 	ThreadId thread = tm.start([&ins, env]() {
 		SchemeThreadManager::impl_p impl(new SchemeImplementation(ins, env));
 		return impl;
 	});
-	// execute multithreading until thread resolved
-	tm.runThreadToCompletion(thread);
+	// execute multithreading until thread resolved, letting any threads it
+	// spawns run alongside it
+	tm.runThreadToCompletion(thread, Multi);
 	// return frame result
 	auto it = tm.getThread(thread);
-	cell result = it->second.getResult();
+	const std::exception_ptr failure(it->getFailure());
+	cell result = failure ? nil : it->getResult();
 	// Remove thread
 	tm.remove_thread(thread);
+	if (failure)
+		std::rethrow_exception(failure);
 	return result;
 }
 cell eval(const cell &ins, env_p parent) {
@@ -647,143 +1108,1741 @@ cell proc_list(const cells & c)
 	return result;
 }
 
-// define the bare minimum set of primintives necessary to pass the unit tests
-void add_globals(environment & env)
-{
-	env["nil"] = nil;   env["#f"] = false_sym;  env["#t"] = true_sym;
-	env["append"] = cell(&proc_append);   env["head"] = cell(&proc_head);
-	env["tail"] = cell(&proc_tail);      env["cons"] = cell(&proc_cons);
-	env["length"] = cell(&proc_length);   env["list"] = cell(&proc_list);
-	env["null?"] = cell(&proc_nullp);    env["+"] = cell(&proc_add);
-	env["-"] = cell(&proc_sub);      env["*"] = cell(&proc_mul);
-	env["/"] = cell(&proc_div);      env[">"] = cell(&proc_greater);
-	env["<"] = cell(&proc_less);     env["<="] = cell(&proc_less_equal);
+////////////////////// numeric vectors
+
+// A homogeneous vector of integers or reals in contiguous storage. Vectors
+// are immutable once built, so cells share them freely.
+struct numeric_vector {
+	enum element_type { Int, Real };
+
+	numeric_vector(element_type element, size_t size) : element(element) {
+		if (element == Int) ints.resize(size); else reals.resize(size);
+	}
+
+	size_t size() const { return element == Int ? ints.size() : reals.size(); }
+	double real(size_t i) const { return element == Int ? (double)ints[i] : reals[i]; }
+
+	// convert an integer vector to reals
+	const std::vector<double> &as_reals(std::vector<double> &tmp) const {
+		if (element == Real)
+			return reals;
+		tmp.assign(ints.begin(), ints.end());
+		return tmp;
+	}
+
+	element_type element;
+	std::vector<int64_t> ints;
+	std::vector<double> reals;
+};
+
+// return given real as a string
+// a real as a string that reads back as the same real, and as a real: in as
+// few digits as will do, and with a decimal point even when it is whole
+std::string str_real(double n) {
+	std::ostringstream os; os.precision(15); os << n;
+	if (strtod(os.str().c_str(), nullptr) != n) {
+		os.str(std::string()); os.precision(17); os << n;
+	}
+	std::string s(os.str());
+	if (s.find_first_not_of("-0123456789") == std::string::npos)
+		s += ".0";
+	return s;
 }
-void add_globals(env_p env) {
-	add_globals(*env);
+
+// whether a Number cell holds an integer
+bool is_integer(const cell &c) { return c.val.find_first_of(".eE") == std::string::npos; }
+int64_t integer_of(const cell &c) { return strtoll(c.val.c_str(), nullptr, 10); }
+double real_of(const cell &c) { return strtod(c.val.c_str(), nullptr); }
+
+const numeric_vector &vector_arg(const cell &c) {
+	if (c.type != Vector)
+		throw std::runtime_error("expected a vector, got " + to_string(c));
+	return *c.vec;
 }
-////////////////////// parse, read and user interaction
 
-// convert given string to list of tokens
-std::list<std::string> tokenize(const std::string & str)
-{
-	std::list<std::string> tokens;
-	const char * s = str.c_str();
-	while (*s) {
-		while (*s == ' ')
-			++s;
-		if (*s == '(' || *s == ')')
-			tokens.push_back(*s++ == '(' ? "(" : ")");
-		else {
-			const char * t = s;
-			while (*t && *t != ' ' && *t != '(' && *t != ')')
-				++t;
-			tokens.push_back(std::string(s, t));
-			s = t;
+// Kernels over contiguous storage. The scalar versions are the reference;
+// on x86 the SSE2 or AVX2 versions are picked once at startup, depending on
+// what the processor supports. Integer arithmetic wraps.
+struct vector_kernels {
+	void (*add_i64)(const int64_t *a, const int64_t *b, int64_t *out, size_t n);
+	void (*add_f64)(const double *a, const double *b, double *out, size_t n);
+	void (*offset_i64)(const int64_t *a, int64_t k, int64_t *out, size_t n);
+	void (*offset_f64)(const double *a, double k, double *out, size_t n);
+	void (*scale_f64)(const double *a, double k, double *out, size_t n);
+	int64_t (*sum_i64)(const int64_t *a, size_t n);
+	double (*sum_f64)(const double *a, size_t n);
+	double (*dot_f64)(const double *a, const double *b, size_t n);
+};
+
+namespace kernels {
+	void add_i64(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+		for (size_t i = 0; i < n; ++i) out[i] = (int64_t)((uint64_t)a[i] + (uint64_t)b[i]);
+	}
+	void add_f64(const double *a, const double *b, double *out, size_t n) {
+		for (size_t i = 0; i < n; ++i) out[i] = a[i] + b[i];
+	}
+	void offset_i64(const int64_t *a, int64_t k, int64_t *out, size_t n) {
+		for (size_t i = 0; i < n; ++i) out[i] = (int64_t)((uint64_t)a[i] + (uint64_t)k);
+	}
+	void offset_f64(const double *a, double k, double *out, size_t n) {
+		for (size_t i = 0; i < n; ++i) out[i] = a[i] + k;
+	}
+	// x86 has no packed 64-bit multiply before AVX-512, so integer scaling
+	// and dot products always use these.
+	void scale_i64(const int64_t *a, int64_t k, int64_t *out, size_t n) {
+		for (size_t i = 0; i < n; ++i) out[i] = (int64_t)((uint64_t)a[i] * (uint64_t)k);
+	}
+	int64_t dot_i64(const int64_t *a, const int64_t *b, size_t n) {
+		uint64_t sum = 0;
+		for (size_t i = 0; i < n; ++i) sum += (uint64_t)a[i] * (uint64_t)b[i];
+		return (int64_t)sum;
+	}
+	void scale_f64(const double *a, double k, double *out, size_t n) {
+		for (size_t i = 0; i < n; ++i) out[i] = a[i] * k;
+	}
+	int64_t sum_i64(const int64_t *a, size_t n) {
+		uint64_t sum = 0;
+		for (size_t i = 0; i < n; ++i) sum += (uint64_t)a[i];
+		return (int64_t)sum;
+	}
+	double sum_f64(const double *a, size_t n) {
+		double sum = 0;
+		for (size_t i = 0; i < n; ++i) sum += a[i];
+		return sum;
+	}
+	double dot_f64(const double *a, const double *b, size_t n) {
+		double sum = 0;
+		for (size_t i = 0; i < n; ++i) sum += a[i] * b[i];
+		return sum;
+	}
+
+#ifdef SCHEME_X86_KERNELS
+	namespace sse2 {
+		__attribute__((target("sse2"))) void add_i64(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_si128((__m128i *)(out + i), _mm_add_epi64(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+			kernels::add_i64(a + i, b + i, out + i, n - i);
+		}
+		__attribute__((target("sse2"))) void add_f64(const double *a, const double *b, double *out, size_t n) {
+			size_t i = 0;
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+			kernels::add_f64(a + i, b + i, out + i, n - i);
+		}
+		__attribute__((target("sse2"))) void offset_i64(const int64_t *a, int64_t k, int64_t *out, size_t n) {
+			size_t i = 0;
+			const __m128i kv = _mm_set1_epi64x(k);
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_si128((__m128i *)(out + i), _mm_add_epi64(_mm_loadu_si128((const __m128i *)(a + i)), kv));
+			kernels::offset_i64(a + i, k, out + i, n - i);
+		}
+		__attribute__((target("sse2"))) void offset_f64(const double *a, double k, double *out, size_t n) {
+			size_t i = 0;
+			const __m128d kv = _mm_set1_pd(k);
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(a + i), kv));
+			kernels::offset_f64(a + i, k, out + i, n - i);
+		}
+		__attribute__((target("sse2"))) void scale_f64(const double *a, double k, double *out, size_t n) {
+			size_t i = 0;
+			const __m128d kv = _mm_set1_pd(k);
+			for (; i + 2 <= n; i += 2)
+				_mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), kv));
+			kernels::scale_f64(a + i, k, out + i, n - i);
+		}
+		__attribute__((target("sse2"))) int64_t sum_i64(const int64_t *a, size_t n) {
+			size_t i = 0;
+			__m128i acc = _mm_setzero_si128();
+			for (; i + 2 <= n; i += 2)
+				acc = _mm_add_epi64(acc, _mm_loadu_si128((const __m128i *)(a + i)));
+			int64_t lanes[2];
+			_mm_storeu_si128((__m128i *)lanes, acc);
+			return (int64_t)((uint64_t)lanes[0] + (uint64_t)lanes[1] + (uint64_t)kernels::sum_i64(a + i, n - i));
+		}
+		__attribute__((target("sse2"))) double sum_f64(const double *a, size_t n) {
+			size_t i = 0;
+			__m128d acc = _mm_setzero_pd();
+			for (; i + 2 <= n; i += 2)
+				acc = _mm_add_pd(acc, _mm_loadu_pd(a + i));
+			double lanes[2];
+			_mm_storeu_pd(lanes, acc);
+			return lanes[0] + lanes[1] + kernels::sum_f64(a + i, n - i);
+		}
+		__attribute__((target("sse2"))) double dot_f64(const double *a, const double *b, size_t n) {
+			size_t i = 0;
+			__m128d acc = _mm_setzero_pd();
+			for (; i + 2 <= n; i += 2)
+				acc = _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+			double lanes[2];
+			_mm_storeu_pd(lanes, acc);
+			return lanes[0] + lanes[1] + kernels::dot_f64(a + i, b + i, n - i);
 		}
 	}
-	return tokens;
+
+	namespace avx2 {
+		__attribute__((target("avx2"))) void add_i64(const int64_t *a, const int64_t *b, int64_t *out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+			kernels::add_i64(a + i, b + i, out + i, n - i);
+		}
+		__attribute__((target("avx2"))) void add_f64(const double *a, const double *b, double *out, size_t n) {
+			size_t i = 0;
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+			kernels::add_f64(a + i, b + i, out + i, n - i);
+		}
+		__attribute__((target("avx2"))) void offset_i64(const int64_t *a, int64_t k, int64_t *out, size_t n) {
+			size_t i = 0;
+			const __m256i kv = _mm256_set1_epi64x(k);
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_si256((__m256i *)(out + i), _mm256_add_epi64(_mm256_loadu_si256((const __m256i *)(a + i)), kv));
+			kernels::offset_i64(a + i, k, out + i, n - i);
+		}
+		__attribute__((target("avx2"))) void offset_f64(const double *a, double k, double *out, size_t n) {
+			size_t i = 0;
+			const __m256d kv = _mm256_set1_pd(k);
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(a + i), kv));
+			kernels::offset_f64(a + i, k, out + i, n - i);
+		}
+		__attribute__((target("avx2"))) void scale_f64(const double *a, double k, double *out, size_t n) {
+			size_t i = 0;
+			const __m256d kv = _mm256_set1_pd(k);
+			for (; i + 4 <= n; i += 4)
+				_mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), kv));
+			kernels::scale_f64(a + i, k, out + i, n - i);
+		}
+		__attribute__((target("avx2"))) int64_t sum_i64(const int64_t *a, size_t n) {
+			size_t i = 0;
+			__m256i acc = _mm256_setzero_si256();
+			for (; i + 4 <= n; i += 4)
+				acc = _mm256_add_epi64(acc, _mm256_loadu_si256((const __m256i *)(a + i)));
+			int64_t lanes[4];
+			_mm256_storeu_si256((__m256i *)lanes, acc);
+			uint64_t sum = (uint64_t)kernels::sum_i64(a + i, n - i);
+			for (int64_t lane : lanes) sum += (uint64_t)lane;
+			return (int64_t)sum;
+		}
+		__attribute__((target("avx2"))) double sum_f64(const double *a, size_t n) {
+			size_t i = 0;
+			__m256d acc = _mm256_setzero_pd();
+			for (; i + 4 <= n; i += 4)
+				acc = _mm256_add_pd(acc, _mm256_loadu_pd(a + i));
+			double lanes[4];
+			_mm256_storeu_pd(lanes, acc);
+			return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + kernels::sum_f64(a + i, n - i);
+		}
+		__attribute__((target("avx2"))) double dot_f64(const double *a, const double *b, size_t n) {
+			size_t i = 0;
+			__m256d acc = _mm256_setzero_pd();
+			for (; i + 4 <= n; i += 4)
+				acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+			double lanes[4];
+			_mm256_storeu_pd(lanes, acc);
+			return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + kernels::dot_f64(a + i, b + i, n - i);
+		}
+	}
+#endif
 }
 
-// numbers become Numbers; every other token is a Symbol
-cell atom(const std::string & token)
+const vector_kernels &select_kernels() {
+	static const vector_kernels scalar = {
+		kernels::add_i64, kernels::add_f64, kernels::offset_i64, kernels::offset_f64,
+		kernels::scale_f64, kernels::sum_i64, kernels::sum_f64, kernels::dot_f64,
+	};
+#ifdef SCHEME_X86_KERNELS
+	static const vector_kernels sse2 = {
+		kernels::sse2::add_i64, kernels::sse2::add_f64, kernels::sse2::offset_i64, kernels::sse2::offset_f64,
+		kernels::sse2::scale_f64, kernels::sse2::sum_i64, kernels::sse2::sum_f64, kernels::sse2::dot_f64,
+	};
+	static const vector_kernels avx2 = {
+		kernels::avx2::add_i64, kernels::avx2::add_f64, kernels::avx2::offset_i64, kernels::avx2::offset_f64,
+		kernels::avx2::scale_f64, kernels::avx2::sum_i64, kernels::avx2::sum_f64, kernels::avx2::dot_f64,
+	};
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return sse2;
+#endif
+	return scalar;
+}
+const vector_kernels &vector_ops = select_kernels();
+
+cell proc_vector(const cells & c)
 {
-	if (isdig(token[0]) || (token[0] == '-' && isdig(token[1])))
-		return cell(Number, token);
-	return cell(Symbol, token);
+	bool integers = true;
+	for (cellit i = c.begin(); i != c.end(); ++i) {
+		if (i->type != Number)
+			throw std::runtime_error("vector elements must be numbers");
+		integers = integers && is_integer(*i);
+	}
+	vector_p v(new numeric_vector(integers ? numeric_vector::Int : numeric_vector::Real, c.size()));
+	for (size_t i = 0; i < c.size(); ++i) {
+		if (integers) v->ints[i] = integer_of(c[i]);
+		else v->reals[i] = real_of(c[i]);
+	}
+	return cell(v);
 }
 
-// return the Lisp expression in the given tokens
-cell read_from(std::list<std::string> & tokens)
+cell proc_list_to_vector(const cells & c) { return proc_vector(c[0].list); }
+
+cell proc_vector_to_list(const cells & c)
 {
-	const std::string token(tokens.front());
-	tokens.pop_front();
-	if (token == "(") {
-		cell c(List);
-		while (tokens.front() != ")")
-			c.list.push_back(read_from(tokens));
-		tokens.pop_front();
-		return c;
-	} else
-		return atom(token);
+	const numeric_vector &v = vector_arg(c[0]);
+	cell result(List);
+	result.list.reserve(v.size());
+	for (size_t i = 0; i < v.size(); ++i)
+		result.list.push_back(v.element == numeric_vector::Int ? cell(Number, str(v.ints[i])) : cell(Number, str_real(v.reals[i])));
+	return result;
 }
 
-// return the Lisp expression represented by the given string
-cell read(const std::string & s)
+cell proc_vector_length(const cells & c) { return cell(Number, str((long)vector_arg(c[0]).size())); }
+
+cell proc_vector_ref(const cells & c)
 {
-	std::list<std::string> tokens(tokenize(s));
-	return read_from(tokens);
+	const numeric_vector &v = vector_arg(c[0]);
+	size_t i = (size_t)atol(c[1].val.c_str());
+	if (i >= v.size())
+		throw std::runtime_error("vector-ref index out of range");
+	return v.element == numeric_vector::Int ? cell(Number, str(v.ints[i])) : cell(Number, str_real(v.reals[i]));
 }
 
-// convert given cell to a Lisp-readable string
-std::string to_string(const cell & exp)
+cell proc_vector_add(const cells & c)
 {
-	if (exp.type == List) {
-		std::string s("(");
-		for (cell::iter e = exp.list.begin(); e != exp.list.end(); ++e)
-			s += to_string(*e) + ' ';
-		if (s[s.size() - 1] == ' ')
-			s.erase(s.size() - 1);
-		return s + ')';
-	} else if (exp.type == Lambda)
-		return "<Lambda>";
-	else if (exp.type == Proc)
-		return "<Proc>";
-	return exp.val;
+	const numeric_vector &a = vector_arg(c[0]), &b = vector_arg(c[1]);
+	if (a.size() != b.size())
+		throw std::runtime_error("vector-add of vectors with different lengths");
+	if (a.element == numeric_vector::Int && b.element == numeric_vector::Int) {
+		vector_p v(new numeric_vector(numeric_vector::Int, a.size()));
+		vector_ops.add_i64(a.ints.data(), b.ints.data(), v->ints.data(), a.size());
+		return cell(v);
+	}
+	std::vector<double> ta, tb;
+	vector_p v(new numeric_vector(numeric_vector::Real, a.size()));
+	vector_ops.add_f64(a.as_reals(ta).data(), b.as_reals(tb).data(), v->reals.data(), a.size());
+	return cell(v);
 }
 
-// the default read-eval-print-loop
-void repl(const std::string & prompt, env_p env)
+// add a number to every element
+cell vector_offset(const numeric_vector &a, const cell &k)
 {
-	for (;;) {
-		std::cout << prompt;
-		std::string line; std::getline(std::cin, line);
-		std::cout << to_string(eval(read(line), env)) << '\n';
+	if (a.element == numeric_vector::Int && is_integer(k)) {
+		vector_p v(new numeric_vector(numeric_vector::Int, a.size()));
+		vector_ops.offset_i64(a.ints.data(), integer_of(k), v->ints.data(), a.size());
+		return cell(v);
 	}
+	std::vector<double> tmp;
+	vector_p v(new numeric_vector(numeric_vector::Real, a.size()));
+	vector_ops.offset_f64(a.as_reals(tmp).data(), real_of(k), v->reals.data(), a.size());
+	return cell(v);
 }
 
-int scheme_main()
+// multiply every element by a number
+cell vector_scale(const numeric_vector &a, const cell &k)
 {
-	env_p global_env(new environment()); add_globals(global_env);
-	repl("90> ", global_env);
-	return 0;
+	if (a.element == numeric_vector::Int && is_integer(k)) {
+		vector_p v(new numeric_vector(numeric_vector::Int, a.size()));
+		kernels::scale_i64(a.ints.data(), integer_of(k), v->ints.data(), a.size());
+		return cell(v);
+	}
+	std::vector<double> tmp;
+	vector_p v(new numeric_vector(numeric_vector::Real, a.size()));
+	vector_ops.scale_f64(a.as_reals(tmp).data(), real_of(k), v->reals.data(), a.size());
+	return cell(v);
 }
 
-void scheme_test() {
-	std::string line;
-	env_p env(new environment()); add_globals(env);
-	eval(read("(define multiply-by (lambda (n) (lambda (y) (* y n))))"), env);
-	eval(read("(define doubler (multiply-by 2))"), env);
-	cell result = eval(read("(doubler 4)"), env);
-	std::cout << to_string(result) << std::endl;
+cell proc_vector_scale(const cells & c) { return vector_scale(vector_arg(c[0]), c[1]); }
+
+cell proc_vector_sum(const cells & c)
+{
+	const numeric_vector &a = vector_arg(c[0]);
+	if (a.element == numeric_vector::Int)
+		return cell(Number, str(vector_ops.sum_i64(a.ints.data(), a.size())));
+	return cell(Number, str_real(vector_ops.sum_f64(a.reals.data(), a.size())));
 }
 
-////////////////////// unit tests
-unsigned g_test_count;      // count of number of unit tests executed
-unsigned g_fault_count;     // count of number of unit tests that fail
-template <typename T1, typename T2>
-void test_equal_(const std::string &expr, const T1 & value, const T2 & expected_value, const char * file, int line)
+cell proc_vector_dot(const cells & c)
 {
-	++g_test_count;
-	std::cerr
-		//<< file
-		<< '(' << "Scheme.cpp:" << line << ") : " << expr << ", "
-		<< " expected " << expected_value
-		<< ", got " << value;
-	if (value != expected_value) {
-		++g_fault_count;
-		std::cerr << " - FAIL\n";
-	} else {
-		std::cerr << " - success\n";
-	}
+	const numeric_vector &a = vector_arg(c[0]), &b = vector_arg(c[1]);
+	if (a.size() != b.size())
+		throw std::runtime_error("vector-dot of vectors with different lengths");
+	if (a.element == numeric_vector::Int && b.element == numeric_vector::Int)
+		return cell(Number, str(kernels::dot_i64(a.ints.data(), b.ints.data(), a.size())));
+	std::vector<double> ta, tb;
+	return cell(Number, str_real(vector_ops.dot_f64(a.as_reals(ta).data(), b.as_reals(tb).data(), a.size())));
 }
-// write a message to std::cout if value != expected_value
-#define TEST_EQUAL(expr, value, expected_value) test_equal_(expr, value, expected_value, __FILE__, __LINE__)
-// evaluate the given Lisp expression and compare the result against the given expected_result
-#define TEST(expr, expected_result) TEST_EQUAL(expr, to_string(eval(read(expr), global_env)), expected_result)
 
-unsigned do_scheme_complete_test();
-unsigned scheme_complete_test() {
+// (vector-map proc vec arg*): apply a builtin to each element, passing any
+// further arguments after the element. Adding to or multiplying by a single
+// number runs a kernel; anything else calls the builtin per element.
+cell proc_vector_map(const cells & c)
+{
+	if (c[0].type != Proc)
+		throw std::runtime_error("vector-map needs a builtin procedure");
+	const numeric_vector &a = vector_arg(c[1]);
+	if (c.size() == 3 && c[2].type == Number) {
+		if (c[0].proc == &proc_add)
+			return vector_offset(a, c[2]);
+		if (c[0].proc == &proc_mul)
+			return vector_scale(a, c[2]);
+	}
+	cells args(c.begin() + 1, c.end());
+	cells results;
+	results.reserve(a.size());
+	for (size_t i = 0; i < a.size(); ++i) {
+		args[0] = a.element == numeric_vector::Int ? cell(Number, str(a.ints[i])) : cell(Number, str_real(a.reals[i]));
+		results.push_back(c[0].proc(args));
+	}
+	return proc_vector(results);
+}
+
+////////////////////// hash tables
+
+// An open-addressing hash table keyed by symbols and numbers, using linear
+// probing over a power-of-two number of slots. Tables are mutable and shared
+// by every cell that refers to them.
+struct hash_table {
+	// A key as it is compared: its hash and, for an integer, its value.
+	// Keys are parsed once, when they are looked up or stored.
+	struct key_info {
+		explicit key_info(const cell &key) : integer(key.type == Number && is_integer(key)), number(integer ? integer_of(key) : 0) {
+			hash = hash_of(key, integer, number);
+		}
+		uint64_t hash;
+		bool integer;
+		int64_t number;
+	};
+
+	struct slot {
+		uint64_t hash;
+		bool used, integer;
+		int64_t number;
+		cell key, value;
+
+		bool matches(const key_info &info, const cell &other) const {
+			if (hash != info.hash || key.type != other.type || integer != info.integer)
+				return false;
+			return integer ? number == info.number : key.val == other.val;
+		}
+	};
+
+	hash_table() : slots(8), count(0) {}
+
+	cell *find(const cell &key) {
+		const key_info info(key);
+		const size_t mask = slots.size() - 1;
+		for (size_t i = (size_t)info.hash & mask; slots[i].used; i = (i + 1) & mask)
+			if (slots[i].matches(info, key))
+				return &slots[i].value;
+		return nullptr;
+	}
+
+	void set(const cell &key, const cell &value) {
+		// Keep the load factor at or below 3/4
+		if ((count + 1) * 4 > slots.size() * 3)
+			grow();
+		const key_info info(key);
+		const size_t mask = slots.size() - 1;
+		size_t i = (size_t)info.hash & mask;
+		for (; slots[i].used; i = (i + 1) & mask) {
+			if (slots[i].matches(info, key)) {
+				slots[i].value = value;
+				return;
+			}
+		}
+		slots[i].hash = info.hash;
+		slots[i].used = true;
+		slots[i].integer = info.integer;
+		slots[i].number = info.number;
+		slots[i].key = key;
+		slots[i].value = value;
+		++count;
+	}
+
+	static uint64_t hash_of(const cell &key, bool integer, int64_t number) {
+		switch (key.type) {
+		case Number:
+			// Integers hash by value, so that 7 and 07 are the same key
+			if (integer)
+				return mix((uint64_t)number);
+			// fall through
+		case Symbol: {
+			// FNV-1a
+			uint64_t h = 14695981039346656037ULL;
+			for (char ch : key.val)
+				h = (h ^ (unsigned char)ch) * 1099511628211ULL;
+			return mix(h ^ key.type);
+		}
+		default:
+			throw std::runtime_error("hash keys must be symbols or numbers, got " + to_string(key));
+		}
+	}
+
+	std::vector<slot, memory::ThreadAllocator<slot>> slots;
+	size_t count;
+
+private:
+	// finalizer from splitmix64, spreads keys across the low bits used for slots
+	static uint64_t mix(uint64_t h) {
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+		return h ^ (h >> 31);
+	}
+
+	void grow() {
+		std::vector<slot, memory::ThreadAllocator<slot>> old(slots.size() * 2);
+		old.swap(slots);
+		const size_t mask = slots.size() - 1;
+		for (slot &s : old) {
+			if (!s.used)
+				continue;
+			size_t i = (size_t)s.hash & mask;
+			while (slots[i].used)
+				i = (i + 1) & mask;
+			slots[i] = s;
+		}
+	}
+};
+
+hash_table &hash_arg(const cell &c) {
+	if (c.type != Hash)
+		throw std::runtime_error("expected a hash table, got " + to_string(c));
+	return *c.hash;
+}
+
+cell proc_make_hash(const cells & c) { return cell(memory::make_shared<hash_table>()); }
+
+// (hash-ref table key [default]); nil when missing and no default is given
+cell proc_hash_ref(const cells & c)
+{
+	const cell *value = hash_arg(c[0]).find(c[1]);
+	if (value)
+		return *value;
+	return c.size() > 2 ? c[2] : nil;
+}
+
+cell proc_hash_set(const cells & c)
+{
+	hash_arg(c[0]).set(c[1], c[2]);
+	return c[2];
+}
+
+cell proc_hash_count(const cells & c) { return cell(Number, str((long)hash_arg(c[0]).count)); }
+
+////////////////////// microthreads
+
+// build an expression calling proc with already evaluated arguments
+cell make_call(const cell &proc, cellit first, cellit last)
+{
+	cell call(List);
+	call.list.push_back(proc);
+	// Quote the arguments so they are not evaluated again
+	for (; first != last; ++first) {
+		cell quoted(List);
+		quoted.list.push_back(cell(Symbol, "quote"));
+		quoted.list.push_back(*first);
+		call.list.push_back(std::move(quoted));
+	}
+	return call;
+}
+
+// environment to evaluate a call to proc in
+env_p call_env(const cell &proc)
+{
+	return proc.env ? proc.env : env_p(new environment());
+}
+
+// (spawn proc arg*): start a thread that calls proc with the given arguments,
+// returning its thread id
+cell proc_spawn(const cells & c)
+{
+	cell call(make_call(c[0], c.begin() + 1, c.end()));
+	env_p env(call_env(c[0]));
+	ThreadId thread = current_manager().start([&call, env]() {
+		return memory::make_pooled<SchemeImplementation>(call, env);
+	});
+	return cell(Number, str((long)thread));
+}
+
+cell proc_self(const cells & c)
+{
+	return cell(Number, str((long)current_manager().getCurrentThread()->first));
+}
+
+// A message as the receiver gets it. Lists are shared with the sender, but a
+// hash table can be changed by whoever holds it, so every table in the message
+// is copied, once however often it appears. Closures still share their
+// environment, as they do within a thread.
+cell message_of(const cell &c, std::map<const hash_table *, hash_p> &copies)
+{
+	switch (c.type) {
+	case Hash: {
+		hash_p &copy = copies[c.hash.get()];
+		if (copy)
+			return cell(copy);
+		copy = std::make_shared<hash_table>(*c.hash);
+		for (hash_table::slot &s : copy->slots)
+			if (s.used)
+				s.value = message_of(s.value, copies);
+		return cell(copy);
+	}
+	case List: {
+		cells items;
+		bool copied = false;
+		for (size_t i = 0; i < c.list.size(); ++i) {
+			const cell &item = c.list[i];
+			cell sent = message_of(item, copies);
+			if (!copied && (sent.hash != item.hash || !sent.list.shares(item.list))) {
+				items.assign(c.list.begin(), c.list.begin() + i);
+				copied = true;
+			}
+			if (copied)
+				items.push_back(std::move(sent));
+		}
+		return copied ? cell(items) : c;
+	}
+	case Symbol: case Number: case Lambda: case Proc: case Vector: case Future:
+		return c;
+	}
+	return c;
+}
+
+// (send thread message): returns #f if the thread does not exist
+cell proc_send(const cells & c)
+{
+	const ThreadId id = (ThreadId)atol(c[0].val.c_str());
+	std::map<const hash_table *, hash_p> copies;
+	return current_manager().send(message_of(c[1], copies), id) ? true_sym : false_sym;
+}
+
+// (receive [timeout-ms]): take the next message from the mailbox. With an
+// empty mailbox the thread is parked until a message arrives, or until the
+// timeout passes, in which case the result is #f.
+cell proc_receive(const cells & c)
+{
+	SchemeThreadManager &manager = current_manager();
+	auto thread = manager.getCurrentThread();
+	auto &mailbox = thread->second.mailbox;
+	SchemeImplementation &impl = *thread->second.impl;
+	if (!mailbox.empty()) {
+		cell message(std::move(mailbox.front()));
+		mailbox.pop();
+		impl.receiving = false;
+		return message;
+	}
+	if (impl.receiving) {
+		// Woken with nothing delivered, the timeout passed
+		impl.receiving = false;
+		return false_sym;
+	}
+	impl.receiving = true;
+	if (c.empty())
+		manager.thread_wait_message(thread->first);
+	else
+		manager.thread_wait_message_for(thread->first, ThreadTimeUnit(atol(c[0].val.c_str())));
+	builtin_blocked = true;
+	return nil;
+}
+
+#ifdef __linux__
+////////////////////// file descriptor I/O
+
+// Reading or writing an fd that is not ready parks the calling thread on the
+// manager's epoll reactor rather than blocking the OS thread. Fds are left in
+// the mode they were given in, as the flag is shared with every process
+// holding them: each read or write first polls the fd and goes ahead only
+// once it is ready. The standard streams belong to the REPL's iostreams,
+// which buffer them, so scripts may not use them.
+
+// The fd in the first argument, which may not be a standard stream
+int script_fd(const cells & c, const char *proc)
+{
+	const int fd = atoi(c[0].val.c_str());
+	if (fd <= STDERR_FILENO)
+		throw std::runtime_error(std::string(proc) + ": fd " + str((long)fd) + " is a standard stream");
+	return fd;
+}
+
+// Whether an I/O call for events on fd would go ahead without blocking. An
+// error or hangup counts, as the call then returns at once with it.
+bool fd_ready(int fd, short events)
+{
+	pollfd p = { fd, events, 0 };
+	return poll(&p, 1, 0) != 0;
+}
+
+void wait_fd(int fd, uint32_t events)
+{
+	SchemeThreadManager &manager = current_manager();
+	if (!manager.thread_wait_fd(manager.getCurrentThread()->first, fd, events))
+		throw std::runtime_error("cannot wait on fd " + str((long)fd) + ": " + strerror(errno));
+	builtin_blocked = true;
+}
+
+// Bytes read past the end of the last line, by fd, until the fd is closed
+thread_local std::map<int, std::string> read_buffers;
+
+// (read-line fd): the next line from fd, without its newline, as a symbol.
+// The result is #f at end of file.
+cell proc_read_line(const cells & c)
+{
+	const int fd = script_fd(c, "read-line");
+	std::string &buffer = read_buffers[fd];
+	for (;;) {
+		const std::string::size_type end = buffer.find('\n');
+		if (end != std::string::npos) {
+			cell line(Symbol, buffer.substr(0, end));
+			buffer.erase(0, end + 1);
+			return line;
+		}
+		if (!fd_ready(fd, POLLIN)) {
+			wait_fd(fd, EPOLLIN);
+			return nil;
+		}
+		char chunk[4096];
+		const ssize_t count = read(fd, chunk, sizeof chunk);
+		if (count > 0) {
+			buffer.append(chunk, count);
+		} else if (count == 0) {
+			// End of file, with or without a last unterminated line
+			cell line(buffer.empty() ? false_sym : cell(Symbol, buffer));
+			read_buffers.erase(fd);
+			return line;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			wait_fd(fd, EPOLLIN);
+			return nil;
+		} else if (errno != EINTR)
+			throw std::runtime_error("read-line: " + std::string(strerror(errno)));
+	}
+}
+
+// (write fd value): write the printed form of value and a newline to fd.
+// Returns the number of bytes written.
+cell proc_write(const cells & c)
+{
+	SchemeImplementation &impl = *current_manager().getCurrentThread()->second.impl;
+	const int fd = script_fd(c, "write");
+	if (!impl.writing) {
+		impl.output = to_string(c[1]) + '\n';
+		impl.written = 0;
+		impl.writing = true;
+	}
+	while (impl.written < impl.output.size()) {
+		if (!fd_ready(fd, POLLOUT)) {
+			wait_fd(fd, EPOLLOUT);
+			return nil;
+		}
+		// A writable pipe has room for PIPE_BUF bytes, so no more go at once
+		const ssize_t count = write(fd, impl.output.data() + impl.written,
+			std::min(impl.output.size() - impl.written, (std::string::size_type)PIPE_BUF));
+		if (count >= 0) {
+			impl.written += count;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			wait_fd(fd, EPOLLOUT);
+			return nil;
+		} else if (errno != EINTR) {
+			impl.writing = false;
+			throw std::runtime_error("write: " + std::string(strerror(errno)));
+		}
+	}
+	impl.writing = false;
+	return cell(Number, str((long)impl.output.size()));
+}
+
+// (close fd): close fd, waking any thread waiting on it to find it closed,
+// and drop what was read ahead of it, so that the next fd given the same
+// number starts afresh
+cell proc_close(const cells & c)
+{
+	const int fd = script_fd(c, "close");
+	current_manager().forget_fd(fd);
+	read_buffers.erase(fd);
+	if (close(fd) < 0)
+		throw std::runtime_error("close: " + std::string(strerror(errno)));
+	return true_sym;
+}
+#endif
+
+////////////////////// futures
+
+// A call evaluated on a pool of worker OS threads. Workers and touch race
+// to claim a pending future, and whoever claims it evaluates it. A future
+// touched before any worker reaches it is evaluated by the toucher, so touch
+// never waits on a queue that it is itself holding up.
+//
+// Futures read globals, without locks, from a snapshot of the global
+// environment taken when they start, so globals may be defined meanwhile
+// but futures do not see them. A future cannot define or set globals
+// itself. The local environments of the calls futures run are shared as
+// they are; changing those, or hash tables that futures use, while futures
+// are running is not supported.
+struct future_state {
+	enum status_type { Pending, Running, Done };
+
+	future_state(const cell &call, env_p env, snapshot_p snapshot)
+		: call(call), env(env), snapshot(snapshot), status(Pending) {}
+
+	// evaluate the call, unless it has already been claimed
+	void run() {
+		int expected = Pending;
+		if (!status.compare_exchange_strong(expected, Running))
+			return;
+		// A manager of its own, as this thread may be in the middle of
+		// evaluating something else
+		SchemeThreadManager manager;
+		snapshot_scope scope(snapshot);
+		try {
+			result = eval(manager, call, env);
+		} catch (...) {
+			error = std::current_exception();
+		}
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			status = Done;
+		}
+		done.notify_all();
+	}
+
+	// wait for and return the result, evaluating it here if still pending
+	cell touch() {
+		run();
+		std::unique_lock<std::mutex> guard(lock);
+		done.wait(guard, [this]() { return status == Done; });
+		if (error)
+			std::rethrow_exception(error);
+		return result;
+	}
+
+private:
+	const cell call;
+	const env_p env;
+	const snapshot_p snapshot;
+	std::atomic<int> status;
+	cell result;
+	std::exception_ptr error;
+	std::mutex lock;
+	std::condition_variable done;
+};
+
+// A fixed pool of OS threads running futures
+struct worker_pool {
+	worker_pool(unsigned count) : stopping(false) {
+		for (unsigned i = 0; i < count; ++i)
+			workers.emplace_back([this]() { work(); });
+	}
+	~worker_pool() {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		ready.notify_all();
+		for (std::thread &worker : workers)
+			worker.join();
+	}
+
+	void submit(future_p future) {
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			queue.push_back(future);
+		}
+		ready.notify_one();
+	}
+
+private:
+	void work() {
+		for (;;) {
+			future_p next;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				ready.wait(guard, [this]() { return stopping || !queue.empty(); });
+				if (queue.empty())
+					return;
+				next = queue.front();
+				queue.pop_front();
+			}
+			next->run();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::deque<future_p> queue;
+	std::mutex lock;
+	std::condition_variable ready;
+	bool stopping;
+};
+
+worker_pool &future_workers() {
+	static worker_pool pool(std::max(2u, std::thread::hardware_concurrency()));
+	return pool;
+}
+
+cell make_future(const cell &proc, cellit first, cellit last)
+{
+	env_p env(call_env(proc));
+	env->prepare_for_sharing();
+	environment *global = env->global();
+	// A future started by a future shares its snapshot
+	snapshot_p snapshot(active_snapshot && active_snapshot->source == global ? *active_owner : global->snapshot());
+	future_p future(new future_state(make_call(proc, first, last), env, snapshot));
+	future_workers().submit(future);
+	return cell(future);
+}
+
+// (future proc arg*): start evaluating a call on a worker thread
+cell proc_future(const cells & c) { return make_future(c[0], c.begin() + 1, c.end()); }
+
+// (touch value): the result of a future; any other value is returned as is
+cell proc_touch(const cells & c) { return c[0].type == Future ? c[0].fut->touch() : c[0]; }
+
+// (pmap proc list): call proc on each element in parallel, results in order
+cell proc_pmap(const cells & c)
+{
+	cells futures;
+	futures.reserve(c[1].list.size());
+	for (cellit i = c[1].list.begin(); i != c[1].list.end(); ++i)
+		futures.push_back(make_future(c[0], i, i + 1));
+	cell result(List);
+	result.list.reserve(futures.size());
+	for (const cell &future : futures)
+		result.list.push_back(future.fut->touch());
+	return result;
+}
+
+// name and implementation of each built-in procedure
+struct builtin {
+	const char *name;
+	cell::proc_type proc;
+};
+
+const builtin builtins[] = {
+	{ "append", &proc_append }, { "head", &proc_head },
+	{ "tail", &proc_tail },     { "cons", &proc_cons },
+	{ "length", &proc_length }, { "list", &proc_list },
+	{ "null?", &proc_nullp },   { "+", &proc_add },
+	{ "-", &proc_sub },         { "*", &proc_mul },
+	{ "/", &proc_div },         { ">", &proc_greater },
+	{ "<", &proc_less },        { "<=", &proc_less_equal },
+	{ "vector", &proc_vector },                 { "list->vector", &proc_list_to_vector },
+	{ "vector->list", &proc_vector_to_list },   { "vector-length", &proc_vector_length },
+	{ "vector-ref", &proc_vector_ref },         { "vector-add", &proc_vector_add },
+	{ "vector-scale", &proc_vector_scale },     { "vector-sum", &proc_vector_sum },
+	{ "vector-dot", &proc_vector_dot },         { "vector-map", &proc_vector_map },
+	{ "make-hash", &proc_make_hash },           { "hash-ref", &proc_hash_ref },
+	{ "hash-set!", &proc_hash_set },            { "hash-count", &proc_hash_count },
+	{ "spawn", &proc_spawn },                   { "self", &proc_self },
+	{ "send", &proc_send },                     { "receive", &proc_receive },
+	{ "future", &proc_future },                 { "touch", &proc_touch },
+	{ "pmap", &proc_pmap },
+#ifdef __linux__
+	{ "read-line", &proc_read_line },           { "write", &proc_write },
+	{ "close", &proc_close },
+#endif
+};
+
+// define the bare minimum set of primintives necessary to pass the unit tests
+void add_globals(environment & env)
+{
+	env["nil"] = nil;   env["#f"] = false_sym;  env["#t"] = true_sym;
+	for (const builtin &b : builtins)
+		env[b.name] = cell(b.proc);
+}
+void add_globals(env_p env) {
+	add_globals(*env);
+}
+
+////////////////////// heap images
+
+// A heap image is a binary snapshot of an environment and everything reachable
+// from it: data, lambdas and the environments they close over. Loading an
+// image maps the file and creates empty environments; each binding is decoded
+// the first time it is looked up. Images use the host byte order.
+//
+// Layout (all integers are uint32_t, offsets are from the start of the file):
+//   header:   magic[8], environment count, root environment, data offset,
+//             table count, table offsets
+//   envs:     { outer (or no_env), binding count, first binding,
+//               refs offset, environment refs, table refs } per environment
+//   bindings: { name offset, name length, cell offset } sorted by name
+//   data:     names, encoded cells, refs, and the offset of each hash
+//             table's contents
+//
+// The refs of an environment are the environments and hash tables that its
+// bindings reach, environment indices first. Each environment holds those
+// until its bindings are decoded, so what an image holds lives exactly as
+// long as it would had it all been decoded at once. The image itself only
+// points at them. Hash tables are created empty when the image is loaded,
+// and filled the first time any reference to them is decoded.
+//
+// Cells are a type byte followed by:
+//   Symbol, Number: length, bytes
+//   List:           count, cells
+//   Proc:           length, builtin name
+//   Lambda:         environment, count, cells
+//
+// An image may refer to one environment it does not contain, such as the
+// global environment of a checkpointed thread. It is written as external_env
+// and supplied when the image is loaded.
+//   Vector:         element type byte, count, 8-byte elements
+//   Hash:           table, length, then where the table is first reached,
+//                   length bytes of count, key and value cells
+//
+// Tables are saved once and referred to wherever they are reached, so
+// tables that are shared, or that contain themselves, load as they were.
+struct heap_image {
+	static const uint32_t no_env = 0xFFFFFFFF;
+	static const uint32_t external_env = 0xFFFFFFFE;
+	static const char magic[8];
+
+	struct header_type { char magic[8]; uint32_t env_count, root, data, table_count, tables; };
+	struct env_record { uint32_t outer, count, first, refs, env_refs, table_refs; };
+	struct binding_record { uint32_t name, length, value; };
+
+	heap_image(const std::string &path);
+	~heap_image();
+
+	// find the offset of a binding's cell, or return false
+	bool find(uint32_t env_index, const text &var, uint32_t &offset) const;
+	cell decode(uint32_t offset) const;
+	text name(const binding_record &b) const {
+		check(b.name, b.length);
+		return text(base + b.name, b.length);
+	}
+
+	const header_type &header() const { return *reinterpret_cast<const header_type *>(base); }
+	const env_record &env(uint32_t index) const {
+		return reinterpret_cast<const env_record *>(base + sizeof(header_type))[index];
+	}
+	const binding_record *bindings() const {
+		return reinterpret_cast<const binding_record *>(base + sizeof(header_type) + sizeof(env_record) * header().env_count);
+	}
+	uint32_t read_u32(uint32_t &offset) const;
+
+	// environments and hash tables created from this image, which decoded
+	// cells refer to. They are held by what refers to them, so the image
+	// does not hold them.
+	std::vector<std::weak_ptr<environment>> envs;
+	std::vector<std::weak_ptr<hash_table>> tables;
+	// the environment standing in for external_env
+	env_p external;
+
+private:
+	cell decode(uint32_t &offset, unsigned depth) const;
+	std::string read_string(uint32_t &offset) const;
+	void check(uint64_t offset, uint64_t length) const {
+		if (offset + length > size)
+			throw std::runtime_error("corrupt heap image");
+	}
+
+	const char *base;
+	size_t size;
+	// whether each table has been filled from the image
+	mutable std::vector<bool> filled;
+#ifdef _WIN32
+	std::vector<char> buffer;
+#endif
+};
+
+const char heap_image::magic[8] = { 'S', 'L', 'S', 'C', 'I', 'M', 'G', '3' };
+
+heap_image::heap_image(const std::string &path) : base(nullptr), size(0) {
+#ifndef _WIN32
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error("cannot open heap image " + path);
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		size = (size_t)st.st_size;
+		void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED)
+			base = static_cast<const char *>(mapping);
+	}
+	close(fd);
+	if (base == nullptr)
+		throw std::runtime_error("cannot map heap image " + path);
+#else
+	std::ifstream in(path, std::ios::binary);
+	if (!in)
+		throw std::runtime_error("cannot open heap image " + path);
+	buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	base = buffer.data();
+	size = buffer.size();
+#endif
+	if (size < sizeof(header_type) || memcmp(header().magic, magic, sizeof(magic)) != 0)
+		throw std::runtime_error("not a heap image: " + path);
+	check(sizeof(header_type), (uint64_t)sizeof(env_record) * header().env_count);
+	if (header().root >= header().env_count)
+		throw std::runtime_error("corrupt heap image");
+	check(header().tables, (uint64_t)sizeof(uint32_t) * header().table_count);
+	filled.assign(header().table_count, false);
+}
+
+heap_image::~heap_image() {
+#ifndef _WIN32
+	if (base)
+		munmap(const_cast<char *>(base), size);
+#endif
+}
+
+bool heap_image::find(uint32_t env_index, const text &var, uint32_t &offset) const {
+	const env_record &rec = env(env_index);
+	const binding_record *first = bindings() + rec.first, *last = first + rec.count;
+	check(reinterpret_cast<const char *>(first) - base, sizeof(binding_record) * rec.count);
+	// Bindings are sorted by name, binary search them
+	while (first < last) {
+		const binding_record *mid = first + (last - first) / 2;
+		check(mid->name, mid->length);
+		int cmp = var.compare(0, std::string::npos, base + mid->name, mid->length);
+		if (cmp == 0) {
+			offset = mid->value;
+			return true;
+		}
+		if (cmp < 0)
+			last = mid;
+		else
+			first = mid + 1;
+	}
+	return false;
+}
+
+uint32_t heap_image::read_u32(uint32_t &offset) const {
+	uint32_t value;
+	check(offset, sizeof(value));
+	memcpy(&value, base + offset, sizeof(value));
+	offset += sizeof(value);
+	return value;
+}
+
+std::string heap_image::read_string(uint32_t &offset) const {
+	uint32_t length = read_u32(offset);
+	check(offset, length);
+	std::string value(base + offset, length);
+	offset += length;
+	return value;
+}
+
+cell heap_image::decode(uint32_t offset) const {
+	return decode(offset, 0);
+}
+
+cell heap_image::decode(uint32_t &offset, unsigned depth) const {
+	if (depth > 10000)
+		throw std::runtime_error("corrupt heap image");
+	check(offset, 1);
+	cell_type type = (cell_type)base[offset++];
+	switch (type) {
+	case Symbol:
+	case Number:
+		return type == Symbol ? symbol(read_string(offset)) : cell(type, read_string(offset));
+	case Proc: {
+		std::string name(read_string(offset));
+		for (const builtin &b : builtins)
+			if (name == b.name)
+				return cell(b.proc);
+		throw std::runtime_error("heap image refers to unknown builtin " + name);
+	}
+	case List:
+	case Lambda: {
+		cell result(type);
+		if (type == Lambda) {
+			uint32_t index = read_u32(offset);
+			if (index == external_env && external)
+				result.env = external;
+			else if (index < envs.size())
+				result.env = envs[index].lock();
+			// Missing from the refs of the environment being decoded
+			if (!result.env)
+				throw std::runtime_error("corrupt heap image");
+		}
+		uint32_t count = read_u32(offset);
+		check(offset, count); // each cell is at least one byte
+		result.list.reserve(count);
+		for (uint32_t i = 0; i < count; ++i)
+			result.list.push_back(decode(offset, depth + 1));
+		return result;
+	}
+	case Vector: {
+		check(offset, 1);
+		numeric_vector::element_type element = (numeric_vector::element_type)base[offset++];
+		if (element != numeric_vector::Int && element != numeric_vector::Real)
+			break;
+		uint32_t count = read_u32(offset);
+		check(offset, (uint64_t)count * 8);
+		vector_p v(new numeric_vector(element, count));
+		memcpy(element == numeric_vector::Int ? (void *)v->ints.data() : (void *)v->reals.data(), base + offset, (size_t)count * 8);
+		offset += count * 8;
+		return cell(v);
+	}
+	case Hash: {
+		const uint32_t index = read_u32(offset), length = read_u32(offset);
+		check(offset, length);
+		hash_p h;
+		if (index < tables.size())
+			h = tables[index].lock();
+		// Missing from the refs of the environment being decoded
+		if (!h)
+			throw std::runtime_error("corrupt heap image");
+		if (!filled[index]) {
+			// Marked first, as the contents may refer back to the table
+			filled[index] = true;
+			uint32_t contents = header().tables + index * (uint32_t)sizeof(uint32_t);
+			contents = read_u32(contents);
+			const uint32_t count = read_u32(contents);
+			check(contents, (uint64_t)count * 2);
+			for (uint32_t i = 0; i < count; ++i) {
+				cell key(decode(contents, depth + 1));
+				h->set(key, decode(contents, depth + 1));
+			}
+		}
+		offset += length;
+		return cell(h);
+	}
+	case Future:
+		// futures are never saved
+		break;
+	}
+	throw std::runtime_error("corrupt heap image");
+}
+
+bool environment::materialize(const text & var) {
+	uint32_t offset;
+	if (!image_->find(image_index_, var, offset))
+		return false;
+	env_[var] = image_->decode(offset);
+	return true;
+}
+
+void environment::materialize_all() {
+	const heap_image::env_record &rec = image_->env(image_index_);
+	for (uint32_t i = 0; i < rec.count; ++i) {
+		const heap_image::binding_record &b = image_->bindings()[rec.first + i];
+		text var(image_->name(b));
+		if (env_.find(var) == env_.end())
+			env_[var] = image_->decode(b.value);
+	}
+	image_.reset();
+	image_refs_.clear();
+	image_tables_.clear();
+}
+
+void environment::prepare_for_sharing() {
+	for (environment *env = this; env; env = env->outer_.get()) {
+		if (!env->image_)
+			continue;
+		// Lambdas decoded later could refer to any environment in the image
+		std::shared_ptr<heap_image> image(env->image_);
+		for (const std::weak_ptr<environment> &weak : image->envs)
+			if (env_p loaded = weak.lock())
+				loaded->bindings();
+	}
+}
+
+// Builds an image of an environment and everything reachable from it
+struct heap_image_writer {
+	heap_image_writer(env_p root, env_p external = nullptr) : external(external) {
+		add(root);
+		// envs grows as closures referring to further environments are found
+		for (size_t i = 0; i < envs.size(); ++i) {
+			env_p env = envs[i];
+			heap_image::env_record rec;
+			rec.outer = env->outer() ? add(env->outer()) : heap_image::no_env;
+			rec.first = (uint32_t)bindings.size();
+			const environment::map &vars = env->bindings();
+			rec.count = (uint32_t)vars.size();
+			env_refs.emplace_back();
+			collecting.push_back(i);
+			for (auto it = vars.cbegin(); it != vars.cend(); ++it) {
+				heap_image::binding_record b;
+				b.name = (uint32_t)data.size();
+				b.length = (uint32_t)it->first.size();
+				data.append(it->first.data(), it->first.size());
+				b.value = (uint32_t)data.size();
+				encode(it->second);
+				bindings.push_back(b);
+			}
+			collecting.pop_back();
+			records.push_back(rec);
+		}
+		// An environment reaches all that the tables it reaches do
+		for (size_t i = 0; i < records.size(); ++i) {
+			refs_type reached(env_refs[i]);
+			std::vector<uint32_t> pending(reached.tables.begin(), reached.tables.end());
+			while (!pending.empty()) {
+				const refs_type &more = table_refs[pending.back()];
+				pending.pop_back();
+				reached.envs.insert(more.envs.begin(), more.envs.end());
+				for (uint32_t table : more.tables)
+					if (reached.tables.insert(table).second)
+						pending.push_back(table);
+			}
+			records[i].refs = (uint32_t)data.size();
+			records[i].env_refs = (uint32_t)reached.envs.size();
+			records[i].table_refs = (uint32_t)reached.tables.size();
+			for (uint32_t ref : reached.envs)
+				put_u32(ref);
+			for (uint32_t ref : reached.tables)
+				put_u32(ref);
+		}
+		tables_at = (uint32_t)data.size();
+		for (uint32_t contents : table_offsets)
+			put_u32(contents);
+	}
+
+	void write(const std::string &path) {
+		heap_image::header_type header;
+		memcpy(header.magic, heap_image::magic, sizeof(header.magic));
+		header.env_count = (uint32_t)records.size();
+		header.root = 0;
+		header.data = (uint32_t)(sizeof(header) + sizeof(heap_image::env_record) * records.size()
+			+ sizeof(heap_image::binding_record) * bindings.size());
+		header.table_count = (uint32_t)table_offsets.size();
+		header.tables = header.data + tables_at;
+		// Offsets were recorded relative to the data section
+		for (auto &b : bindings) {
+			b.name += header.data;
+			b.value += header.data;
+		}
+		for (auto &rec : records)
+			rec.refs += header.data;
+		for (size_t i = 0; i < table_offsets.size(); ++i) {
+			const uint32_t contents = table_offsets[i] + header.data;
+			memcpy(&data[tables_at + i * sizeof(uint32_t)], &contents, sizeof(contents));
+		}
+		// Write beside the target and rename over it, so that environments
+		// still mapping an older image of the same name are not disturbed.
+		const std::string temp(path + ".tmp");
+		{
+			std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+			out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char *>(records.data()), sizeof(heap_image::env_record) * records.size());
+			out.write(reinterpret_cast<const char *>(bindings.data()), sizeof(heap_image::binding_record) * bindings.size());
+			out.write(data.data(), data.size());
+			if (!out)
+				throw std::runtime_error("cannot write heap image " + path);
+		}
+#ifdef _WIN32
+		std::remove(path.c_str());
+#endif
+		if (std::rename(temp.c_str(), path.c_str()) != 0)
+			throw std::runtime_error("cannot write heap image " + path);
+	}
+
+private:
+	uint32_t add(const env_p &env) {
+		if (external && env == external)
+			return heap_image::external_env;
+		auto it = index.find(env.get());
+		if (it != index.end())
+			return it->second;
+		uint32_t i = (uint32_t)envs.size();
+		index[env.get()] = i;
+		envs.push_back(env);
+		return i;
+	}
+
+	void put_u32(uint32_t value) {
+		data.append(reinterpret_cast<const char *>(&value), sizeof(value));
+	}
+	void put_string(const text &value) {
+		put_u32((uint32_t)value.size());
+		data.append(value.data(), value.size());
+	}
+
+	void encode(const cell &c) {
+		data += (char)c.type;
+		switch (c.type) {
+		case Symbol:
+		case Number:
+			put_string(c.val);
+			return;
+		case Proc:
+			for (const builtin &b : builtins) {
+				if (b.proc == c.proc) {
+					put_string(b.name);
+					return;
+				}
+			}
+			throw std::runtime_error("cannot save a procedure that is not a builtin");
+		case Lambda: {
+			const uint32_t env = add(c.env);
+			if (env != heap_image::external_env)
+				for (refs_type *refs : collectors())
+					refs->envs.insert(env);
+			put_u32(env);
+		}
+			// fall through
+		case List:
+			put_u32((uint32_t)c.list.size());
+			for (const cell &item : c.list)
+				encode(item);
+			return;
+		case Vector:
+			data += (char)c.vec->element;
+			put_u32((uint32_t)c.vec->size());
+			if (c.vec->element == numeric_vector::Int)
+				data.append(reinterpret_cast<const char *>(c.vec->ints.data()), c.vec->size() * 8);
+			else
+				data.append(reinterpret_cast<const char *>(c.vec->reals.data()), c.vec->size() * 8);
+			return;
+		case Hash: {
+			auto found = table_index.find(c.hash.get());
+			const uint32_t table = found != table_index.end() ? found->second : (uint32_t)table_offsets.size();
+			for (refs_type *refs : collectors())
+				refs->tables.insert(table);
+			put_u32(table);
+			if (found != table_index.end()) {
+				// Saved already, or being saved further out
+				put_u32(0);
+				return;
+			}
+			table_index[c.hash.get()] = table;
+			table_offsets.push_back(0);
+			table_refs.emplace_back();
+			const size_t length_at = data.size();
+			put_u32(0);
+			table_offsets[table] = (uint32_t)data.size();
+			collecting.push_back(~(size_t)table);
+			put_u32((uint32_t)c.hash->count);
+			for (const hash_table::slot &s : c.hash->slots) {
+				if (s.used) {
+					encode(s.key);
+					encode(s.value);
+				}
+			}
+			collecting.pop_back();
+			const uint32_t length = (uint32_t)(data.size() - length_at - sizeof(uint32_t));
+			memcpy(&data[length_at], &length, sizeof(length));
+			return;
+		}
+		case Future:
+			throw std::runtime_error("cannot save a future");
+		}
+	}
+
+	const env_p external;
+	std::map<environment *, uint32_t> index;
+	std::vector<env_p> envs;
+	std::vector<heap_image::env_record> records;
+	std::vector<heap_image::binding_record> bindings;
+	std::string data;
+
+	// What an environment's bindings, or a table's contents, reach
+	struct refs_type {
+		std::set<uint32_t> envs, tables;
+	};
+	std::vector<refs_type> env_refs, table_refs;
+	// The environment and tables being written, outermost first. Tables are
+	// stored complemented, so as to tell them from environments.
+	std::vector<size_t> collecting;
+	std::vector<refs_type *> collectors() {
+		std::vector<refs_type *> result;
+		for (size_t at : collecting)
+			result.push_back(at < env_refs.size() ? &env_refs[at] : &table_refs[~at]);
+		return result;
+	}
+	std::map<const hash_table *, uint32_t> table_index;
+	// offset of each table's contents within data
+	std::vector<uint32_t> table_offsets;
+	uint32_t tables_at = 0;
+};
+
+// save an environment, and everything reachable from it, to a heap image
+void save_image(const std::string &path, env_p env) {
+	heap_image_writer(env).write(path);
+}
+
+// load a heap image, returning the environment it was saved from. external
+// stands in for the environment the image was saved without, if any.
+env_p load_image(const std::string &path, env_p external = nullptr) {
+	std::shared_ptr<heap_image> image(new heap_image(path));
+	image->external = external;
+	const uint32_t count = image->header().env_count;
+	// Held here until each is held by what refers to it
+	std::vector<env_p> envs;
+	envs.reserve(count);
+	for (uint32_t i = 0; i < count; ++i) {
+		env_p env(new environment());
+		env->image_ = image;
+		env->image_index_ = i;
+		envs.push_back(env);
+	}
+	image->envs.assign(envs.begin(), envs.end());
+	std::vector<hash_p> tables;
+	tables.reserve(image->header().table_count);
+	for (uint32_t i = 0; i < image->header().table_count; ++i)
+		tables.push_back(std::make_shared<hash_table>());
+	image->tables.assign(tables.begin(), tables.end());
+	// Link outer environments and refs
+	for (uint32_t i = 0; i < count; ++i) {
+		const heap_image::env_record &rec = image->env(i);
+		if (rec.outer == heap_image::external_env && external)
+			envs[i]->outer_ = external;
+		else if (rec.outer != heap_image::no_env) {
+			if (rec.outer >= count)
+				throw std::runtime_error("corrupt heap image");
+			envs[i]->outer_ = envs[rec.outer];
+		}
+		uint32_t offset = rec.refs;
+		envs[i]->image_refs_.reserve(rec.env_refs);
+		for (uint32_t n = 0; n < rec.env_refs; ++n) {
+			const uint32_t ref = image->read_u32(offset);
+			if (ref >= count)
+				throw std::runtime_error("corrupt heap image");
+			envs[i]->image_refs_.push_back(envs[ref]);
+		}
+		envs[i]->image_tables_.reserve(rec.table_refs);
+		for (uint32_t n = 0; n < rec.table_refs; ++n) {
+			const uint32_t ref = image->read_u32(offset);
+			if (ref >= tables.size())
+				throw std::runtime_error("corrupt heap image");
+			envs[i]->image_tables_.push_back(tables[ref]);
+		}
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		environment *global = envs[i].get();
+		for (unsigned depth = 0; global->outer_ && global != external.get(); global = global->outer_.get())
+			if (++depth > count)
+				throw std::runtime_error("corrupt heap image");
+		envs[i]->global_ = global == external.get() ? external->global_ : global;
+	}
+	return envs[image->header().root];
+}
+
+cell read(const std::string & s); // forward declaration; see parser below
+
+// Definitions every session starts with, on top of the builtins. Remove
+// saved prelude images after changing these.
+const char *const prelude[] = {
+	"(define map (lambda (f l) (if (null? l) nil (cons (f (head l)) (map f (tail l))))))",
+	"(define filter (lambda (p l) (if (null? l) nil (if (p (head l)) (cons (head l) (filter p (tail l))) (filter p (tail l))))))",
+	"(define fold (lambda (f acc l) (if (null? l) acc (fold f (f acc (head l)) (tail l)))))",
+	"(define compose (lambda (f g) (lambda (x) (f (g x)))))",
+};
+
+// The global environment for a session. It is loaded from the heap image at
+// path when there is one. Otherwise it is built with add_globals and the
+// prelude, and saved to path, if given, for the sessions that follow.
+env_p global_environment(const std::string &path = std::string())
+{
+	if (!path.empty()) {
+		try {
+			return load_image(path);
+		} catch (const std::runtime_error &) {
+			// No image yet, or not a usable one; build it afresh
+		}
+	}
+	env_p env(new environment()); add_globals(env);
+	for (const char *definition : prelude)
+		eval(read(definition), env);
+	if (!path.empty())
+		save_image(path, env);
+	return env;
+}
+
+////////////////////// checkpoints
+
+// A checkpoint is a heap image whose root environment holds a thread: its
+// frames from the outermost in, its mailbox, and any write in progress.
+// The shared environment is left out of the image and supplied on restore,
+// so only what the thread has built up itself is written.
+//
+// A receive in progress starts over when the thread resumes, with a fresh
+// timeout. File descriptors, and lines read ahead of them, do not carry over.
+
+void SchemeImplementation::checkpoint(const std::string &path, const Mailbox<cell> &mailbox, env_p shared) const
+{
+	cell frames(List), messages(List);
+	for (const SchemeFrame *f = &frame; f != nullptr; f = f->subframe)
+		frames.list.push_back(f->saveState());
+	Mailbox<cell> pending(mailbox);
+	for (; !pending.empty(); pending.pop())
+		messages.list.push_back(pending.front());
+	env_p state(new environment());
+	state->bind("frames", frames);
+	state->bind("mailbox", messages);
+	state->bind("output", cell(Symbol, output));
+	state->bind("written", cell(Number, str((long)written)));
+	state->bind("writing", writing ? true_sym : false_sym);
+	heap_image_writer(state, shared).write(path);
+}
+
+std::shared_ptr<SchemeImplementation> SchemeImplementation::restore(const std::string &path, Mailbox<cell> &mailbox, env_p shared)
+{
+	env_p state(load_image(path, shared));
+	const environment::map &saved = state->bindings();
+	auto get = [&saved](const char *name) -> const cell & {
+		auto it = saved.find(name);
+		if (it == saved.end())
+			throw std::runtime_error("corrupt checkpoint");
+		return it->second;
+	};
+	const cells &frames = get("frames").list;
+	if (frames.empty())
+		throw std::runtime_error("corrupt checkpoint");
+	// The root frame lives in the implementation, so start it with a
+	// constant and take on the saved state in place
+	std::shared_ptr<SchemeImplementation> impl(new SchemeImplementation(cell(Number, "0"), shared));
+	impl->frame.loadState(frames[0]);
+	SchemeFrame *last = &impl->frame;
+	for (auto it = frames.cbegin() + 1; it != frames.cend(); ++it)
+		last = last->subframe = SchemeFrame::restoreState(*it);
+	for (const cell &message : get("mailbox").list)
+		mailbox.push(message);
+	impl->output = str(get("output").val);
+	impl->written = (std::string::size_type)atol(get("written").val.c_str());
+	impl->writing = get("writing").val == true_sym.val;
+	return impl;
+}
+////////////////////// parse, read and user interaction
+
+// convert given string to list of tokens
+std::list<std::string> tokenize(const std::string & str)
+{
+	std::list<std::string> tokens;
+	const char * s = str.c_str();
+	while (*s) {
+		while (*s == ' ')
+			++s;
+		if (*s == '(' || *s == ')')
+			tokens.push_back(*s++ == '(' ? "(" : ")");
+		else {
+			const char * t = s;
+			while (*t && *t != ' ' && *t != '(' && *t != ')')
+				++t;
+			tokens.push_back(std::string(s, t));
+			s = t;
+		}
+	}
+	return tokens;
+}
+
+// numbers become Numbers; every other token is a Symbol
+cell atom(const std::string & token)
+{
+	if (isdig(token[0]) || (token[0] == '-' && isdig(token[1])))
+		return cell(Number, token);
+	return symbol(token);
+}
+
+// return the Lisp expression in the given tokens
+cell read_from(std::list<std::string> & tokens)
+{
+	const std::string token(tokens.front());
+	tokens.pop_front();
+	if (token == "(") {
+		cell c(List);
+		while (tokens.front() != ")")
+			c.list.push_back(read_from(tokens));
+		tokens.pop_front();
+		return c;
+	} else
+		return atom(token);
+}
+
+// return the Lisp expression represented by the given string
+cell read(const std::string & s)
+{
+	std::list<std::string> tokens(tokenize(s));
+	return read_from(tokens);
+}
+
+// convert given cell to a Lisp-readable string
+std::string to_string(const cell & exp)
+{
+	if (exp.type == List) {
+		std::string s("(");
+		for (cell::iter e = exp.list.begin(); e != exp.list.end(); ++e)
+			s += to_string(*e) + ' ';
+		if (s[s.size() - 1] == ' ')
+			s.erase(s.size() - 1);
+		return s + ')';
+	} else if (exp.type == Lambda)
+		return "<Lambda>";
+	else if (exp.type == Vector) {
+		std::string s("#(");
+		for (size_t i = 0; i < exp.vec->size(); ++i) {
+			if (i) s += ' ';
+			s += exp.vec->element == numeric_vector::Int ? str(exp.vec->ints[i]) : str_real(exp.vec->reals[i]);
+		}
+		return s + ')';
+	}
+	else if (exp.type == Proc)
+		return "<Proc>";
+	else if (exp.type == Hash)
+		return "<Hash>";
+	else if (exp.type == Future)
+		return "<Future>";
+	return str(exp.val);
+}
+
+// the default read-eval-print-loop
+void repl(const std::string & prompt, env_p env)
+{
+	for (;;) {
+		std::cout << prompt;
+		std::string line; std::getline(std::cin, line);
+		std::cout << to_string(eval(read(line), env)) << '\n';
+	}
+}
+
+// stackless scheme [prelude-image]: a REPL whose globals are loaded from
+// the prelude image, which is written first if it does not exist yet
+int scheme_main(int argc, char *argv[])
+{
+	env_p global_env(global_environment(argc > 0 ? argv[0] : ""));
+	repl("90> ", global_env);
+	return 0;
+}
+
+void scheme_test() {
+	std::string line;
+	env_p env(new environment()); add_globals(env);
+	eval(read("(define multiply-by (lambda (n) (lambda (y) (* y n))))"), env);
+	eval(read("(define doubler (multiply-by 2))"), env);
+	cell result = eval(read("(doubler 4)"), env);
+	std::cout << to_string(result) << std::endl;
+}
+
+////////////////////// unit tests
+unsigned g_test_count;      // count of number of unit tests executed
+unsigned g_fault_count;     // count of number of unit tests that fail
+template <typename T1, typename T2>
+void test_equal_(const std::string &expr, const T1 & value, const T2 & expected_value, const char * file, int line)
+{
+	++g_test_count;
+	std::cerr
+		//<< file
+		<< '(' << "Scheme.cpp:" << line << ") : " << expr << ", "
+		<< " expected " << expected_value
+		<< ", got " << value;
+	if (value != expected_value) {
+		++g_fault_count;
+		std::cerr << " - FAIL\n";
+	} else {
+		std::cerr << " - success\n";
+	}
+}
+// write a message to std::cout if value != expected_value
+#define TEST_EQUAL(expr, value, expected_value) test_equal_(expr, value, expected_value, __FILE__, __LINE__)
+// evaluate the given Lisp expression and compare the result against the given expected_result
+#define TEST(expr, expected_result) TEST_EQUAL(expr, to_string(eval(read(expr), global_env)), expected_result)
+
+// a file name in the temporary directory, unique to this process
+std::string temp_path(const std::string &name)
+{
+#ifdef _WIN32
+	const char *dir = std::getenv("TEMP");
+	return std::string(dir ? dir : ".") + "\\" + str((long)_getpid()) + "-" + name;
+#else
+	const char *dir = std::getenv("TMPDIR");
+	return std::string(dir ? dir : "/tmp") + "/" + str((long)getpid()) + "-" + name;
+#endif
+}
+
+unsigned do_scheme_complete_test();
+unsigned scheme_complete_test() {
 	unsigned result;
 	auto duration = StacklessTimekeeper::measure([&result]() {
 		result = do_scheme_complete_test();
@@ -835,6 +2894,347 @@ unsigned do_scheme_complete_test() {
 	TEST("(riff-shuffle (list 1 2 3 4 5 6 7 8))", "(1 5 2 6 3 7 4 8)");
 	TEST("((repeat riff-shuffle) (list 1 2 3 4 5 6 7 8))", "(1 3 5 7 2 4 6 8)");
 	TEST("(riff-shuffle (riff-shuffle (riff-shuffle (list 1 2 3 4 5 6 7 8))))", "(1 2 3 4 5 6 7 8)");
+	// inline caches are invalidated by redefinition and shadowing
+	TEST("(define g (lambda () 1))", "<Lambda>");
+	TEST("(define h (lambda () (g)))", "<Lambda>");
+	TEST("(h)", "1");
+	TEST("(define g (lambda () 2))", "<Lambda>");
+	TEST("(h)", "2");
+	TEST("(define k (lambda () (begin (define g (lambda () 3)) (g))))", "<Lambda>");
+	TEST("(k)", "3");
+	TEST("(h)", "2");
+	// numeric vectors
+	TEST("(define v (vector 1 2 3 4 5 6 7 8 9))", "#(1 2 3 4 5 6 7 8 9)");
+	TEST("(vector-add v v)", "#(2 4 6 8 10 12 14 16 18)");
+	TEST("(vector-scale v 3)", "#(3 6 9 12 15 18 21 24 27)");
+	TEST("(vector-sum v)", "45");
+	TEST("(vector-dot v v)", "285");
+	TEST("(vector-map + v 10)", "#(11 12 13 14 15 16 17 18 19)");
+	TEST("(vector-map - v 1)", "#(0 1 2 3 4 5 6 7 8)");
+	TEST("(define r (list->vector (list 0.5 1.5 2.5 3.5 4.5)))", "#(0.5 1.5 2.5 3.5 4.5)");
+	TEST("(vector-sum r)", "12.5");
+	TEST("(vector-dot r (vector 2 2 2 2 2))", "25.0");
+	TEST("(vector-add v (vector-scale v 0.5))", "#(1.5 3.0 4.5 6.0 7.5 9.0 10.5 12.0 13.5)");
+	TEST("(vector-map * r 2)", "#(1.0 3.0 5.0 7.0 9.0)");
+	TEST("(vector 1.0 3.0)", "#(1.0 3.0)");
+	TEST("(vector-sum (vector 0.1 0.2))", "0.30000000000000004");
+	TEST("(vector->list (vector-map * v 2))", "(2 4 6 8 10 12 14 16 18)");
+	TEST("(vector-ref r 4)", "4.5");
+	TEST("(vector-length v)", "9");
+	// hash tables
+	TEST("(define ht (make-hash))", "<Hash>");
+	TEST("(hash-set! ht (quote apple) 3)", "3");
+	TEST("(hash-set! ht 42 (list 1 2))", "(1 2)");
+	TEST("(hash-ref ht (quote apple))", "3");
+	TEST("(hash-ref ht 42)", "(1 2)");
+	TEST("(hash-ref ht (quote pear))", "nil");
+	TEST("(hash-ref ht (quote pear) 0)", "0");
+	TEST("(define fill (lambda (n) (if (<= n 0) ht (begin (hash-set! ht n (* n n)) (fill (- n 1))))))", "<Lambda>");
+	TEST("(hash-count (fill 100))", "101");
+	TEST("(hash-ref ht 64)", "4096");
+	TEST("(hash-set! ht (quote apple) 4)", "4");
+	TEST("(hash-count ht)", "101");
+	// microthreads
+	TEST("(define echo (lambda (from) (send from (list (quote echo) (receive)))))", "<Lambda>");
+	TEST("(begin (send (spawn echo (self)) (quote hi)) (receive))", "(echo hi)");
+	TEST("(define square-to (lambda (parent x) (send parent (* x x))))", "<Lambda>");
+	TEST("(begin (spawn square-to (self) 3) (spawn square-to (self) 4) (+ (receive) (receive)))", "25");
+	TEST("(receive 5)", "#f");
+	TEST("(define relay (lambda (to) (send to (receive 1000))))", "<Lambda>");
+	TEST("(begin (send (spawn relay (self)) (quote late)) (receive))", "late");
+	// messages share their lists, but each table is copied once
+	{
+		const cell sent(read("(a (b c) d)"));
+		cell kept(sent);
+		TEST_EQUAL("copied list shares its items", kept.list.shares(sent.list), true);
+		kept.list.push_back(nil);
+		TEST_EQUAL("changed copy has its own items", to_string(sent), "(a (b c) d)");
+		std::map<const hash_table *, hash_p> copies;
+		TEST_EQUAL("message without tables is shared", message_of(sent, copies).list.shares(sent.list), true);
+	}
+	TEST("(define bump (lambda (from) ((lambda (t) (begin (hash-set! t (quote k) 2) (send from t))) (receive))))", "<Lambda>");
+	TEST("(define sent (make-hash))", "<Hash>");
+	TEST("(hash-set! sent (quote k) 1)", "1");
+	TEST("(begin (send (spawn bump (self)) sent) (hash-ref (receive) (quote k)))", "2");
+	TEST("(hash-ref sent (quote k))", "1");
+	TEST("(define same-table (lambda (from) ((lambda (m) (begin (hash-set! (head m) (quote k) 3) (send from (hash-ref (head (tail m)) (quote k))))) (receive))))", "<Lambda>");
+	TEST("(begin (send (spawn same-table (self)) (list sent sent)) (receive))", "3");
+	TEST("(hash-ref sent (quote k))", "1");
+	TEST("(define idle (lambda (n) (if (<= n 0) nil (cons (spawn receive) (idle (- n 1))))))", "<Lambda>");
+	TEST("(define wake-all (lambda (ids) (if (null? ids) 0 (begin (send (head ids) 0) (wake-all (tail ids))))))", "<Lambda>");
+	{
+		const size_t threads = SchemeThreadMan.threadCount(), parked = SchemeThreadMan.parkedCount();
+		TEST("(begin (define idlers (idle 100)) (receive 1))", "#f");
+		TEST_EQUAL("parked receivers", SchemeThreadMan.parkedCount(), parked + 100);
+		TEST("(begin (wake-all idlers) (receive 1))", "#f");
+		TEST_EQUAL("woken receivers finished", SchemeThreadMan.threadCount(), threads);
+	}
+	{
+		const size_t parked = SchemeThreadMan.parkedCount();
+		TEST("(begin (define lonely (spawn receive)) (receive 1))", "#f");
+		const ThreadId id = (ThreadId)atol(eval(read("lonely"), global_env).val.c_str());
+		TEST_EQUAL("parked thread found", SchemeThreadMan.getThread(id) != nullptr, true);
+		TEST_EQUAL("lookup leaves it parked", SchemeThreadMan.parkedCount(), parked + 1);
+		SchemeThreadMan.send(cell(Number, "0"), id);
+		TEST_EQUAL("message unparks it", SchemeThreadMan.parkedCount(), parked);
+		TEST("(receive 1)", "#f");
+		TEST_EQUAL("woken thread finished", SchemeThreadMan.getThread(id) == nullptr, true);
+	}
+	// futures
+	TEST("(touch (future + 1 2))", "3");
+	TEST("(touch 5)", "5");
+	TEST("(pmap fact (list 1 2 3 4 5 6 7 8 9 10))", "(1 2 6 24 120 720 5040 40320 362880 3628800)");
+	TEST("(pmap (lambda (n) (touch (future fact n))) (list 3 4 5))", "(6 24 120)");
+	TEST("(pmap riff-shuffle (list (list 1 2 3 4) (list 5 6 7 8)))", "((1 3 2 4) (5 7 6 8))");
+	TEST("(pmap (lambda (x) (begin (spawn square-to (self) x) (receive))) (list 2 3))", "(4 9)");
+	// globals defined while futures run, which read them from a snapshot
+	TEST("(define count-down (lambda (n) (if (<= n 0) 0 (+ 1 (count-down (- n 1))))))", "<Lambda>");
+	for (long n = 0; n < 8; ++n)
+		TEST("(define in-flight-" + str(n) + " (future count-down 400))", "<Future>");
+	for (long n = 0; n < 200; ++n)
+		TEST("(define filler-" + str(n) + " " + str(n) + ")", str(n));
+	TEST("(define count-down 0)", "0");
+	for (long n = 0; n < 8; ++n)
+		TEST("(define in-flight-" + str(n) + " (touch in-flight-" + str(n) + "))", "400");
+	{
+		const cell setter(eval(read("(future (lambda () (set! fact 1)))"), global_env));
+		bool refused = false;
+		try {
+			setter.fut->touch();
+		} catch (const std::runtime_error &) {
+			refused = true;
+		}
+		TEST_EQUAL("future cannot set a global", refused, true);
+	}
+	TEST("(fact 5)", "120");
+#ifdef __linux__
+	// fd I/O
+	{
+		int pipe_fds[2], socket_fds[2];
+		TEST_EQUAL("pipe", pipe(pipe_fds), 0);
+		TEST_EQUAL("socketpair", socketpair(AF_UNIX, SOCK_STREAM, 0, socket_fds), 0);
+		const std::string in(str((long)pipe_fds[0])), out(str((long)pipe_fds[1]));
+		const std::string near(str((long)socket_fds[0])), far(str((long)socket_fds[1]));
+		TEST("(define line-to (lambda (parent fd) (send parent (read-line fd))))", "<Lambda>");
+		TEST("(begin (spawn line-to (self) " + in + ") (write " + out + " (quote hello)) (receive))", "hello");
+		TEST("(define echo-line (lambda (fd) (write fd (list (quote echo) (read-line fd)))))", "<Lambda>");
+		TEST("(begin (spawn echo-line " + far + ") (write " + near + " (quote ping)) (read-line " + near + "))", "(echo ping)");
+		// The fds are polled, not switched to non-blocking mode
+		TEST_EQUAL("reader left blocking", fcntl(pipe_fds[0], F_GETFL) & O_NONBLOCK, 0);
+		TEST_EQUAL("writer left blocking", fcntl(pipe_fds[1], F_GETFL) & O_NONBLOCK, 0);
+		TEST_EQUAL("socket left blocking", fcntl(socket_fds[0], F_GETFL) & O_NONBLOCK, 0);
+		{
+			bool refused = false;
+			try {
+				eval(read("(read-line 0)"), global_env);
+			} catch (const std::runtime_error &) {
+				refused = true;
+			}
+			TEST_EQUAL("standard streams refused", refused, true);
+			TEST_EQUAL("stdin untouched", fcntl(0, F_GETFL) & O_NONBLOCK, 0);
+		}
+		// More than the pipe holds, so both ends block part way
+		fcntl(pipe_fds[1], F_SETPIPE_SZ, 4096);
+		TEST("(define triple (lambda (x) (list x x x)))", "<Lambda>");
+		TEST("(begin (define big ((repeat (repeat (repeat triple))) 12345)) (length big))", "3");
+		TEST_EQUAL("large write", to_string(eval(read("(begin (spawn line-to (self) " + in + ") (write " + out + " big) (receive))"), global_env)),
+			to_string(eval(read("big"), global_env)));
+		close(pipe_fds[1]);
+		TEST("(read-line " + in + ")", "#f");
+		TEST("(close " + in + ")", "#t");
+		TEST("(close " + near + ")", "#t");
+		TEST("(close " + far + ")", "#t");
+		// Lines read ahead do not outlive the fd
+		TEST_EQUAL("pipe", pipe(pipe_fds), 0);
+		const std::string first_in(str((long)pipe_fds[0])), first_out(str((long)pipe_fds[1]));
+		TEST("(begin (write " + first_out + " (quote a)) (write " + first_out + " (quote b)) (read-line " + first_in + "))", "a");
+		TEST("(begin (close " + first_in + ") (close " + first_out + "))", "#t");
+		TEST_EQUAL("pipe", pipe(pipe_fds), 0);
+		const std::string second_in(str((long)pipe_fds[0])), second_out(str((long)pipe_fds[1]));
+		TEST_EQUAL("fd number reused", second_in, first_in);
+		TEST("(begin (write " + second_out + " (quote c)) (read-line " + second_in + "))", "c");
+		// Closing an fd wakes the thread waiting on it
+		const size_t threads = SchemeThreadMan.threadCount(), parked = SchemeThreadMan.parkedCount();
+		TEST("(begin (spawn line-to (self) " + second_in + ") (receive 1))", "#f");
+		TEST_EQUAL("reader waiting", SchemeThreadMan.parkedCount(), parked + 1);
+		TEST("(begin (close " + second_in + ") (close " + second_out + ") (receive 1))", "#f");
+		TEST_EQUAL("closing woke the reader", SchemeThreadMan.parkedCount(), parked);
+		TEST_EQUAL("woken reader finished", SchemeThreadMan.threadCount(), threads);
+	}
+#endif
+	// memory quotas
+	TEST("(define deep (lambda (n) (+ 1 (deep n))))", "<Lambda>");
+	SchemeThreadMan.setThreadQuota(256 * 1024);
+	{
+		const size_t threads = SchemeThreadMan.threadCount();
+		TEST("(begin (spawn deep 1) (receive 20))", "#f");
+		TEST_EQUAL("failed thread removed", SchemeThreadMan.threadCount(), threads);
+	}
+	{
+		bool exceeded = false;
+		try {
+			eval(read("(deep 1)"), global_env);
+		} catch (const stackless::memory::QuotaExceeded &) {
+			exceeded = true;
+		}
+		TEST_EQUAL("quota exceeded", exceeded, true);
+	}
+	TEST("(fact 12)", "479001600");
+	SchemeThreadMan.setThreadQuota(0);
+	// a thread that throws fails alone
+	{
+		const size_t threads = SchemeThreadMan.threadCount();
+		TEST("(begin (spawn vector-ref (vector 1) 5) (receive 20))", "#f");
+		TEST_EQUAL("thrown thread removed", SchemeThreadMan.threadCount(), threads);
+	}
+	// checkpoints
+	TEST("(define sum-to (lambda (acc) ((lambda (n) (if (<= n 0) acc (sum-to (+ acc n)))) (receive))))", "<Lambda>");
+	{
+		const size_t threads = SchemeThreadMan.threadCount(), parked = SchemeThreadMan.parkedCount();
+		const std::string path(temp_path("scheme_test.ckp"));
+		const cell start(read("(sum-to 0)"));
+		ThreadId id = SchemeThreadMan.start([&start, global_env]() {
+			return SchemeThreadManager::impl_p(new SchemeImplementation(start, global_env));
+		});
+		SchemeThreadMan.send(cell(Number, "5"), id);
+		SchemeThreadMan.send(cell(Number, "7"), id);
+		// Run until both are summed and the thread parks for more
+		while (SchemeThreadMan.parkedCount() == parked)
+			SchemeThreadMan.executeThreads();
+		SchemeThreadMan.send(cell(Number, "9"), id);
+		TEST_EQUAL("suspend", SchemeThreadMan.suspend(id, path, global_env), true);
+		TEST_EQUAL("suspended thread removed", SchemeThreadMan.threadCount(), threads);
+		id = SchemeThreadMan.resume(path, global_env);
+		SchemeThreadMan.send(cell(Number, "0"), id);
+		SchemeThreadMan.runThreadToCompletion(id, Multi);
+		TEST_EQUAL("resumed thread", to_string(SchemeThreadMan.getThread(id)->getResult()), "21");
+		SchemeThreadMan.remove_thread(id);
+		std::remove(path.c_str());
+	}
+	// profiling
+	{
+		stackless::profiling::Profiler profiler(1);
+		SchemeThreadMan.setProfiler(&profiler);
+		TEST("(fact 5)", "120");
+		SchemeThreadMan.setProfiler(nullptr);
+		TEST("(fact 5)", "120");
+		std::ostringstream folded;
+		profiler.write(folded);
+		TEST_EQUAL("profile samples", profiler.sampleCount() > 0, true);
+		TEST_EQUAL("profile of nested calls", folded.str().find(";fact;*;fact;*;fact") != std::string::npos, true);
+	}
+	// samples are the profiler's, not the sampled thread's
+	TEST("(define fact-then-wait (lambda (n) (begin (fact n) (receive))))", "<Lambda>");
+	SchemeThreadMan.setThreadQuota(256 * 1024);
+	{
+		auto arena_used = [&global_env](const std::string &name) {
+			const ThreadId id = (ThreadId)atol(eval(read(name), global_env).val.c_str());
+			return SchemeThreadMan.getThread(id)->getArena()->getUsed();
+		};
+		TEST("(begin (define unprofiled (spawn fact-then-wait 10)) (receive 1))", "#f");
+		stackless::profiling::Profiler profiler(1);
+		SchemeThreadMan.setProfiler(&profiler);
+		TEST("(begin (define profiled (spawn fact-then-wait 10)) (receive 1))", "#f");
+		TEST("(fact 12)", "479001600");
+		SchemeThreadMan.setProfiler(nullptr);
+		TEST_EQUAL("profiled thread sampled", profiler.sampleCount() > 0, true);
+		TEST_EQUAL("samples not charged to the thread", arena_used("profiled"), arena_used("unprofiled"));
+		TEST("(begin (send unprofiled 0) (send profiled 0) (receive 1))", "#f");
+	}
+	SchemeThreadMan.setThreadQuota(0);
+	// timing
+	{
+		Histogram histogram;
+		for (uint64_t n = 1; n <= 100000; ++n)
+			histogram.record(n);
+		TEST_EQUAL("histogram p50", histogram.percentile(50) >= 50000 && histogram.percentile(50) <= 51600, true);
+		TEST_EQUAL("histogram p999", histogram.percentile(99.9) >= 99900 && histogram.percentile(99.9) <= 100000, true);
+		TEST_EQUAL("histogram max", histogram.max(), (uint64_t)100000);
+		PhaseTimers timers;
+		SchemeThreadMan.setTimers(&timers);
+		TEST("(fact 5)", "120");
+		TEST("(receive 2)", "#f");
+		SchemeThreadMan.setTimers(nullptr);
+		TEST_EQUAL("eval timed", timers.find("eval") != nullptr && timers.find("eval")->count() == 2, true);
+		TEST_EQUAL("slices timed", timers.find("slice")->count() > 0, true);
+		TEST_EQUAL("wakes timed", timers.find("wake late")->count() > 0, true);
+	}
+	// completion
+	{
+		const size_t threads = SchemeThreadMan.threadCount();
+		SchemeThreadManager::group_p group(std::make_shared<SchemeThreadManager::_group_type>());
+		std::vector<ThreadId> ids;
+		for (long n = 1; n <= 10; ++n) {
+			const cell start(read("(fact " + str(n) + ")"));
+			ids.push_back(SchemeThreadMan.start([&start, global_env]() {
+				return SchemeThreadManager::impl_p(new SchemeImplementation(start, global_env));
+			}));
+			SchemeThreadMan.addToGroup(group, ids.back());
+		}
+		SchemeThreadManager::_future_type future(SchemeThreadMan.future(ids[4]));
+		int joined = 0;
+		group->join([&joined](SchemeThreadManager::_group_type &) { ++joined; });
+		SchemeThreadMan.runGroupToCompletion(group);
+		TEST_EQUAL("group joined once", joined, 1);
+		TEST_EQUAL("group completions", group->completions().size(), (size_t)10);
+		long sum = 0;
+		for (const auto &completion : group->completions())
+			sum += atol(completion.result.val.c_str());
+		TEST_EQUAL("group results", sum, 4037913);
+		TEST_EQUAL("future", to_string(future.get()), "120");
+		TEST_EQUAL("finished threads removed", SchemeThreadMan.threadCount(), threads);
+		TEST_EQUAL("future of removed thread", SchemeThreadMan.future(ids[0]).completion().resolved, false);
+	}
+	// heap images
+	TEST("(define shared (make-hash))", "<Hash>");
+	TEST("(hash-set! shared (quote self) shared)", "<Hash>");
+	TEST("(define sharing (list shared))", "(<Hash>)");
+	const std::string image_path(temp_path("scheme_test.img"));
+	save_image(image_path, global_env);
+	{
+		env_p global_env(load_image(image_path));
+		TEST("(hash-set! (head sharing) 1 2)", "2");
+		TEST("(hash-ref shared 1)", "2");
+		TEST("(hash-ref (hash-ref (hash-ref shared (quote self)) (quote self)) 1)", "2");
+		TEST("(fact 12)", "479001600");
+		TEST("((repeat twice) 5)", "20");
+		TEST("(zip (list 1 2) (list 3 4))", "((1 3) (2 4))");
+		TEST("(define y (quote (a (b c))))", "(a (b c))");
+		TEST("(vector-sum r)", "12.5");
+		TEST("(hash-ref ht 99)", "9801");
+		save_image(image_path, global_env);
+	}
+	{
+		env_p global_env(load_image(image_path));
+		TEST("y", "(a (b c))");
+		TEST("(riff-shuffle (list 1 2 3 4 5 6 7 8))", "(1 5 2 6 3 7 4 8)");
+	}
+	{
+		env_p data(new environment());
+		data->bind("adder", eval(read("((lambda (n) (lambda (x) (+ x n))) 5)"), global_env));
+		heap_image_writer(data, global_env).write(image_path);
+		std::weak_ptr<environment> weak;
+		{
+			env_p loaded(load_image(image_path, global_env));
+			weak = loaded;
+			TEST_EQUAL("image closure", to_string(eval(read("(adder 1)"), loaded)), "6");
+		}
+		TEST_EQUAL("image environments freed", weak.expired(), true);
+	}
+	std::remove(image_path.c_str());
+	// prelude images
+	{
+		const std::string prelude_path(temp_path("prelude.img"));
+		env_p built(global_environment(prelude_path));
+		std::ifstream saved(prelude_path, std::ios::binary);
+		TEST_EQUAL("prelude image saved", saved.good(), true);
+		saved.close();
+		env_p global_env(global_environment(prelude_path));
+		TEST("(map (lambda (x) (* x x)) (list 1 2 3))", "(1 4 9)");
+		TEST("(fold + 0 (filter (lambda (x) (> x 1)) (list 1 2 3)))", "5");
+		TEST("((compose head tail) (list 1 2 3))", "2");
+		std::remove(prelude_path.c_str());
+	}
 	std::cout
 		<< "total tests " << g_test_count
 		<< ", total failures " << g_fault_count
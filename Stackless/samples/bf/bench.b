@@ -0,0 +1,8 @@
+Loop benchmark: three nested counting loops of 100 by 250 by 250
+Written for the Stackless corpus; the inner body clears a cell so it cannot
+be folded into a single instruction and every iteration is dispatched
+Prints A
+
+[-]+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++[>[-]------[>[-]------[->[-]+>+<<]<-]<-]>
+>>>+++++++++++++++++++++++++++++++++++++++++++++++++.>++++++++++.[-]
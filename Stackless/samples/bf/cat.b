@@ -0,0 +1,3 @@
+Copy input to output until the end of input which reads as 0
+
+,[.,]
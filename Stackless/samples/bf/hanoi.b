@@ -0,0 +1,251 @@
+Towers of Hanoi: moves 10 disks from peg A to peg C
+Written for the Stackless corpus; a binary counter picks the disk to move
+and each disk cycles through the pegs in a fixed direction
+
++[>>[->>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>
+>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]
+<<<<<<<<<<<<<<<<<<<<<<<[-]>[->>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<
+<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>
+>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<<<[-]>[->>>>>>>>>>>>>>
+>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<
+<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<
+<<<<<<<<<<<<<<<[-]>[->>>>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<
+<<<<<]>>>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>
+>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<<<<<[-]>[->>>>>>>>>>
+>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]
+>[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<[-]>[->>>>>>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<
+<<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<
+<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<
+<<<<<<<<<<<<[-]>[->>>>>>>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<
+<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[
+-]>[->>>>>>>>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<]>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[-]>[->>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[-]>[->>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>
+>>>>>>>>>>>>>>>>>>>>>>>>]<+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<[-]<
+<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>+++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++++++++++
++++++++++++++++++++++++.+++++++.-----------------.----------------------
+-----------------------------------------------.++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++.+++++.++++++++++.--------.-
+------------------------------------------------------------------------
+--.+++++++++++++++++.-.----------------.++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++.++++++++++++.---.--.-------------
+----------------------------------------------------------------.[-]<<<<
+<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<<<<<<]>>>>>>
+>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>]<+++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]<<<<<<<<<<
+<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>
+>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>]<<-->+<[[
+-]>[-]<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<
+<<<<<<[-]>>>>>>>>>>>>>>>>>>>>>>]<<<<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>
+>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<
+<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<<+
+>>>>>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>>>>
+>>]<++++++++++++++++++++++++++++++++.+++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++.-----.----------------
+---------------------------------------------------------------.[-]<<<<<
+<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<<<<<<]>>>>>>>
+>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>]<++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]++++++++++.
+[-]<]<<<]>[[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>
+>>>>>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++.++++++++++++++++++++++++++++++++++.+++++++.-----------------
+.---------------------------------------------------------------------.+
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.++++
++.++++++++++.--------.--------------------------------------------------
+-------------------------.+++++++++++++++++++++++++.--------------------
+-----.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++.++++++++++++.---.--.-----------------------------------------------
+------------------------------.[-]<<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>
+>>>>+>+<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<
+<+>>>>>>>>>>>>>>>>>>>>>]<+++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++.[-]<<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>>+>>+<<<<
+<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<<+>>>>>>
+>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>
+>>]>[[-]<<<<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>>>>>]<+++++++++++++++++
++++++++++++++++.++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++.-----.-------------------------------------
+------------------------------------------.[-]<<<<<<<<<<<<<<<<<<<<[->>>>
+>>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<
+<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>]<+++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++.[-]++++++++++.[-]<]<<<]>[[-]<<<<<<<<<<<<<
+<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>>+++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++++++++++++++++
++++++++++++++++++.+++++++.-----------------.----------------------------
+-----------------------------------------.++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++.+++++.++++++++++.--------.-------
+--------------------------------------------------------------------.+++
++++++++++++++++++++++.------------------------.+++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++.++++++++++++.---.--.------
+-----------------------------------------------------------------------.
+[-]<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<<<<]>>>>>
+>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>]<++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]<<<<<<<<<<<<<<<
+<<<<[->>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>>
+[-<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<<<<<<<
+<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>
+>>>>>>]<<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<<
+<]>>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>]<<-
+->+<[[-]>[-]<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<
+<<<<<<[-]>>>>>>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++.++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++.-----.-------------------------------------------------------------
+------------------.[-]<<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>>+>+<<<<<<<
+<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>
+>>>>>]<+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+.[-]++++++++++.[-]<]<<<]>[[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>
+>>>>>>>>>>>>>>>>>+++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++.++++++++++++++++++++++++++++++++++.+++++++.------
+-----------.------------------------------------------------------------
+---------.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++.+++++.++++++++++.--------.---------------------------------------
+------------------------------------.+++++++++++++++++++++++.-----------
+------------.+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++.++++++++++++.---.--.----------------------------------------
+-------------------------------------.[-]<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>
+>>>>>>>+>+<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<+>
+>>>>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++.[-]<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<
+<<<<<<<]>>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>]
+<<-->+<[[-]>[-]<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<
+<<<<<<[-]>>>>>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++.+++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++.-----.--------------------------------------------------------------
+-----------------.[-]<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>>+>+<<<<<<<<<<
+<<<<<<<<<]>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]<
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]+++
++++++++.[-]<]<<<]>[[-]<<<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>
+>>>>>>>>++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++.++++++++++++++++++++++++++++++++++.+++++++.---------------
+--.---------------------------------------------------------------------
+.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.++
++++.++++++++++.--------.------------------------------------------------
+---------------------------.++++++++++++++++++++++.---------------------
+-.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+.++++++++++++.---.--.---------------------------------------------------
+--------------------------.[-]<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>+>+<<<
+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>
+>]<+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]
+<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>
+>>>>>>>[-<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<<<<
+<<<<<<<<<<+>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>>
+>]<<<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<<<]>>>>>>>>>
+>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<
+<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>
+>>>>]<++++++++++++++++++++++++++++++++.+++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++.-----.--------------
+-----------------------------------------------------------------.[-]<<<
+<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>
+>[-<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++.[-]++++++++++.[-]<]<<<]>[[-]<<<<<<<<
+<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>>++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++.++++++++++++++++++
+++++++++++++++++.+++++++.-----------------.-----------------------------
+----------------------------------------.+++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++.+++++.++++++++++.--------.--------
+-------------------------------------------------------------------.++++
++++++++++++++++++.---------------------.++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++.++++++++++++.---.--.-------------
+----------------------------------------------------------------.[-]<<<<
+<<<<<<<<<<<<[->>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>[-<<
+<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<+++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++.[-]<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>+>>+<<
+<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>
+>>]<<-->+<[[-]>[-]<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<
+<<<[-]>>>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++.++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.-
+----.-------------------------------------------------------------------
+------------.[-]<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<<]>
+>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<+++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++.[-]++++++++++.[-]<]<<<]
+>[[-]<<<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>>>+++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.+++++++
++++++++++++++++++++++++++++.+++++++.-----------------.------------------
+---------------------------------------------------.++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++.+++++.++++++++++.------
+--.---------------------------------------------------------------------
+------.++++++++++++++++++++.--------------------.+++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++.++++++++++++.---.--.----
+------------------------------------------------------------------------
+-.[-]<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>
+>[-<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++.[-]<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>+>>+<
+<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]
+<<-->+<[[-]>[-]<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<[-]
+>>>>>>>>>>>>>>>>]<<<<<<<<<<<<<<<<[->>>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<<]
+>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<
+<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>]
+<++++++++++++++++++++++++++++++++.++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++.-----.-------------------
+------------------------------------------------------------.[-]<<<<<<<<
+<<<<<<<[->>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>[-<<<<<<<<<<
+<<<<<<+>>>>>>>>>>>>>>>>]<+++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++.[-]++++++++++.[-]<]<<<]>[[-]<<<<<<<<<<<<<<<<<<<<<<<<<
++>>>>>>>>>>>>>>>>>>>>>>>>>>+++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++.++++++++++++++++++++++++++++++++++.++++
++++.-----------------.--------------------------------------------------
+-------------------.++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++.+++++.++++++++++.--------.-----------------------------
+----------------------------------------------.+++++++++++++++++++.-----
+--------------.+++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++.++++++++++++.---.--.--------------------------------------
+---------------------------------------.[-]<<<<<<<<<<<<<<[->>>>>>>>>>>>>
+>+>+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]<++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]<<<<<
+<<<<<<<<<[->>>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>[-<<<<<<<<
+<<<<<<<<+>>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]
+>[[-]<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++
+.+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++.-----.----------------------------------------------------
+---------------------------.[-]<<<<<<<<<<<<<<[->>>>>>>>>>>>>>+>+<<<<<<<<
+<<<<<<<]>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]<++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++.[-]++++++++++.[-]<]<
+<<]>[[-]<<<<<<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>>>>>>>++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.++++++++
+++++++++++++++++++++++++++.+++++++.-----------------.-------------------
+--------------------------------------------------.+++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++.+++++.++++++++++.-------
+-.----------------------------------------------------------------------
+-----.++++++++++++++++++.------------------.++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++.++++++++++++.---.--.---------
+--------------------------------------------------------------------.[-]
+<<<<<<<<<<<<<[->>>>>>>>>>>>>+>+<<<<<<<<<<<<<<]>>>>>>>>>>>>>>[-<<<<<<<<<<
+<<<<+>>>>>>>>>>>>>>]<+++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++.[-]<<<<<<<<<<<<<[->>>>>>>>>>>>>+>>+<<<<<<<<<<<<<<<]>>>>>>
+>>>>>>>>>[-<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>]<<-->+<[[-]>[-]<<<<<<<<<<<<<<
++>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>]<<<<<<<<<<<<<<[->>>>
+>>>>>>>>>+>>+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<+>>>>>>>>>>
+>>>>>]<<-->+<[[-]>[-]<<<<<<<<<<<<<<+>>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<<[-]
+>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++.+++++++++++++++++++++++
++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++.-----.----
+------------------------------------------------------------------------
+---.[-]<<<<<<<<<<<<<[->>>>>>>>>>>>>+>+<<<<<<<<<<<<<<]>>>>>>>>>>>>>>[-<<<
+<<<<<<<<<<<+>>>>>>>>>>>>>>]<++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++.[-]++++++++++.[-]<]<<<]>[[-]<<<<<<<<<<<<<<<<<<<<<<
+<+>>>>>>>>>>>>>>>>>>>>>>>>++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++.++++++++++++++++++++++++++++++++++.+++++
+++.-----------------.---------------------------------------------------
+------------------.+++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++.+++++.++++++++++.--------.------------------------------
+---------------------------------------------.+++++++++++++++++.--------
+---------.++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++.++++++++++++.---.--.-------------------------------------------
+----------------------------------.[-]<<<<<<<<<<<<[->>>>>>>>>>>>+>+<<<<<
+<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<<<+>>>>>>>>>>>>>]<+++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++.[-]<<<<<<<<<<<<[->>>>>>>>
+>>>>+>>+<<<<<<<<<<<<<<]>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<<-
+->+<[[-]>[-]<<<<<<<<<<<<<+>>>>>>>>>>>>]>[[-]<<<<<<<<<<<<<[-]>>>>>>>>>>>>
+>]<++++++++++++++++++++++++++++++++.++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++.-----.-----------------
+--------------------------------------------------------------.[-]<<<<<<
+<<<<<<[->>>>>>>>>>>>+>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<<<+>>>>>>
+>>>>>>>]<+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++.[-]++++++++++.[-]<]<<<<<<<<<<<<<<<<<<<<<<<<<]
@@ -0,0 +1,68 @@
+Mandelbrot set in 48 columns by 21 rows
+Written for the Stackless corpus: fixed point with 4 fraction bits in
+signed 8 bit cells and up to 12 iterations a point
+
+>>[-]--------------------<<[-]+++++++++++++++++++++[>>>[-]--------------
+------------------<<[-]++++++++++++++++++++++++++++++++++++++++++++++++[
+>>>[-]>[-]>[-]>[-]+[>[-]<<<<[->>>>+>>>>>>>>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<
+<<<<<<<<<<<+>>>>>>>>>>>>]<<<<<<<[-]+<<<<<[->>>>>>>>>>>>+>>+<<<<<<<<<<<<<
+<]>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<+++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++++++++++++++++[-<[->>+>>+<<<<]>>>>[-<<<<+>>>>]<+<[[-]
+>[-]<<<->>]>[[-]<<<<<<<<<<[-]>>>>>>>>>>]<<]<[-]<<<<<<<[->>>>>>>+>+<<<<<<
+<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<[[-]<<<<<<<<[-]<<<<[->>>>>>>>>>>>>+>+<<<
+<<<<<<<<<<<]>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<[-<<<<<<<<<->
+>>>>>>>>]<]<<<<<<[-]<<<<<[->>>>>+>>>>>>+<<<<<<<<<<<]>>>>>>>>>>>[-<<<<<<<
+<<<<+>>>>>>>>>>>]<<<<<[-]+<<<<<<[->>>>>>>>>>>+>>+<<<<<<<<<<<<<]>>>>>>>>>
+>>>>[-<<<<<<<<<<<<<+>>>>>>>>>>>>>]<+++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++++++++++++++[-<[->>+>>+<<<<]>>>>[-<<<<+>>>>]<+<[[-]>[-]<<<->>]>[[
+-]<<<<<<<<[-]>>>>>>>>]<<]<[-]<<<<<[->>>>>+>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>
+]<[[-]<<<<<<[-]<<<<<[->>>>>>>>>>>>+>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<
+<<<<<<<+>>>>>>>>>>>>>]<[-<<<<<<<->>>>>>>]<]<[-]+<<<<<<<[->>>>>>>>>+>>+<<
+<<<<<<<<<]>>>>>>>>>>>[-<<<<<<<<<<<+>>>>>>>>>>>]<++++++++++++++++++++++++
++++++++++[-<[->>+>>+<<<<]>>>>[-<<<<+>>>>]<+<[[-]>[-]<<<->>]>[[-]<<<<<[-]
+>>>>>]<<]<[-]<<[->+<][-]+<<<<<[->>>>>>>+>>+<<<<<<<<<]>>>>>>>>>[-<<<<<<<<
+<+>>>>>>>>>]<+++++++++++++++++++++++++++++++++[-<[->>+>>+<<<<]>>>>[-<<<<
++>>>>]<+<[[-]>[-]<<<->>]>[[-]<<<<<[-]>>>>>]<<]<[-]<<[->+<]>[->+>>+<<<]>>
+>[-<<<+>>>]<+<[[-]>[-]<<<<<<<<<<<[-]>>>>>>>>>>]>[[-]<<<<<<[-]>>>>>>>++++
+++++++++++++<<<<<<<<<<<[->>>>>>>>>>>>+>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<
+<<<<<<<<<<+>>>>>>>>>>>>>]<[-<<<<<<<<<<<<[->>>>>>>>>>>>>+>+<<<<<<<<<<<<<<
+]>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<[-<<-[->>>+>>+<<<<<]>>>>
+>[-<<<<<+>>>>>]<+<[[-]>[-]<]>[[-]<<<<<<<<<<<+>>>>>>>++++++++++++++++>>>>
+]<<]<]<[-]<<<<<<[-]>>>>>>++++++++++++++++<<<<<<<<<[->>>>>>>>>>+>+<<<<<<<
+<<<<]>>>>>>>>>>>[-<<<<<<<<<<<+>>>>>>>>>>>]<[-<<<<<<<<<<[->>>>>>>>>>>+>+<
+<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<[-<<-[->>>+>>+<<<<<
+]>>>>>[-<<<<<+>>>>>]<+<[[-]>[-]<]>[[-]<<<<<<<<<<+>>>>>>++++++++++++++++>
+>>>]<<]<]<[-]<<<<<<<[->>>>>>>+>+<<<<<<<<]>>>>>>>>[-<<<<<<<<+>>>>>>>>]<<<
+<<<<[->>>>>>+>+<<<<<<<]>>>>>>>[-<<<<<<<+>>>>>>>]<<<<<[-]+>>>>[->+>>+<<<]
+>>>[-<<<+>>>]<++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
++++++++[-<[->>+>>+<<<<]>>>>[-<<<<+>>>>]<+<[[-]>[-]<<<->>]>[[-]<<<<<<<<[-
+]>>>>>>>>]<<]<[-]<[-]<<<<[->>>>+>>+<<<<<<]>>>>>>[-<<<<<<+>>>>>>]<+<[[-]>
+[-]<<<<<<<<<<<<<[-]>>>>>>>>>>>>]>[[-]<<<<<<[-]>>>>>>>++++++++<<<<<<<<<<<
+<<[->>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<+>>
+>>>>>>>>>>>>>]<[-<<<<<<<<<<<<[->>>>>>>>>>>>>+>+<<<<<<<<<<<<<<]>>>>>>>>>>
+>>>>[-<<<<<<<<<<<<<<+>>>>>>>>>>>>>>]<[-<<-[->>>+>>+<<<<<]>>>>>[-<<<<<+>>
+>>>]<+<[[-]>[-]<]>[[-]<<<<<<<<<<<+>>>>>>>++++++++>>>>]<<]<]<[-]<<<<<<<<<
+<<<<<<<<[-]<[->+>>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>>>[
+-<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>]<<<<<<<<<[-<<<<<<<<+>>>>>>>>]>[-<
+<<<<<<<<->>>>>>>>>]<<<<<<<<[-]<<<[->>>+>>>>>>>>>>>>>>>>+<<<<<<<<<<<<<<<<
+<<<]>>>>>>>>>>>>>>>>>>>[-<<<<<<<<<<<<<<<<<<<+>>>>>>>>>>>>>>>>>>>]<<<<<<<
+<<<<<[->>>>>>>>>>>>+>+<<<<<<<<<<<<<]>>>>>>>>>>>>>[-<<<<<<<<<<<<<+>>>>>>>
+>>>>>>]<<<<<<<<<<<[->>>>>>>>>>>+>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<
+<+>>>>>>>>>>>>]<[[-]<[->>+>>+<<<<]>>>>[-<<<<+>>>>]<+<[[-]>[-]<<<[-]>>]>[
+[-]<<<+>>>]<<]<[->+>>+<<<]>>>[-<<<+>>>]<+<[[-]>[-]<<<<<<<<<[-<<<<<<<<<->
+>>>>>>>>]>>>>>>>>]>[[-]<<<<<<<<<[-<<<<<<<<<+>>>>>>>>>]>>>>>>>>>]<<[-]<<<
+<<<<<<<<<<<<+[->>>>>>>>>>>>>>>+>+<<<<<<<<<<<<<<<<]>>>>>>>>>>>>>>>>[-<<<<
+<<<<<<<<<<<<+>>>>>>>>>>>>>>>>]<------------[->+>>+<<<]>>>[-<<<+>>>]<+<[[
+-]>[-]<]>[[-]<<<<<<<<<<<<<<<<[-]>>>>>>>>>>>>>>>>]<<[-]<]<<<<<<<<[-]>[-]>
+>[-]>>>]<<[-]<<<<<<<<<]>>>>>>>>>++++++++++++++++++++++++++++++++<<<<<<<<
+<<[->>>>>>>>>>>+>+<<<<<<<<<<<<]>>>>>>>>>>>>[-<<<<<<<<<<<<+>>>>>>>>>>>>]<
+[->+>+<<]>>[-<<+>>]<[[-]<<++++++++++++++>->]<[->+>+<<]>>[-<<+>>]<[[-]<<-
+->->]<[->+>+<<]>>[-<<+>>]<[[-]<<++++++++++++++>->]<[->+>+<<]>>[-<<+>>]<[
+[-]<<+>->]<[->+>+<<]>>[-<<+>>]<[[-]<<-------------->->]<[->+>+<<]>>[-<<+
+>>]<[[-]<<++++++++++++++++>->]<[->+>+<<]>>[-<<+>>]<[[-]<<---------------
+--->->]<[->+>+<<]>>[-<<+>>]<[[-]<<->->]<[->+>+<<]>>[-<<+>>]<[[-]<<----->
+->]<[->+>+<<]>>[-<<+>>]<[[-]<<-->->]<[->+>+<<]>>[-<<+>>]<[[-]<<+++>->]<[
+->+>+<<]>>[-<<+>>]<[[-]<<++++++++++++++++++++++++++>->]<<.[-]>[-]<<<<<<<
+<<<<<<<+<<-]>>>>>>>>>>>>>>>++++++++++.[-]<<<<<<<<<<<<<<++<<-]
@@ -0,0 +1,7 @@
+Reverse input
+Reads every character to the end of input then prints them last first and
+a newline; the end of input reads as 0
+
+>,[>,]                          read into cells 1 onwards until 0
+<[.<]                           print back down to cell 0
+++++++++++.
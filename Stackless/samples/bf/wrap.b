@@ -0,0 +1,24 @@
+Cell and tape wraparound
+Cells are 8 bits and wrap in both directions; the tape is 32768 cells and
+wraps at either end as well
+Prints ABCNZ
+
+-                               0 minus 1 is 255
+>++++++++[<++++++++>-]<         add 64 for 319 which wraps to 63
+++.                             65 is A
+[-]
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+                                256 increments leave cell 0 at 0
+++++++++[>++++++++<-]>++.       so cell 1 gets 8 times 8 plus 2 for B
+<<                              left of cell 0 is cell 32767
++++++++[>+++++++++<-]           its loop puts 63 in cell 0 by wrapping right
+>++++.                          67 is C
+<>>>>                           from cell 32767 four right is cell 3
++++++++++++[<<<<+>>>>-]<<<<     move 11 from cell 3 left across cell 0
+>[<+>-]<.                       add cell 0 for 78 which is N
+[-]-                            cell 32767 is 255 again
+>+++++++++++++++[<----------->-]<.   less 165 is 90 which is Z
+[-]++++++++++.                  newline